@@ -0,0 +1,75 @@
+#ifndef DATASETGENERATOR_H
+#define DATASETGENERATOR_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "RecordFile.h"
+#include "ReplayBuffer.h"
+
+// Self-play data generator. every worker of the rollout pool plays its own games, scores the legal moves
+// of every position with compute_scores (serial inside the worker) and plays the best move. records are
+// collected per worker and appended to the record file (RecordFile.h) in chunks of chunk_records, so
+// memory does not grow with the dataset. run() continues an existing file: the records in it count
+// towards the total, and the games of the resumed run draw from other streams than those of the runs
+// before, also with the same seed. a file whose header names other samples, depth or policy is not
+// continued, run() throws runtime_error; a setting of -1 in the header (unknown or mixed) takes any
+// a generator on a replay buffer pushes the chunks into the buffer instead, for a trainer that samples
+// from it while the games are played; run() then counts the records of this run
+class DatasetGenerator {
+public:
+    DatasetGenerator(const std::string& path, int samples, int depth, int policy, size_t chunk_records = 4096);
+    DatasetGenerator(std::shared_ptr<ReplayBuffer> buffer, int samples, int depth, int policy, size_t chunk_records = 4096);
+
+    DatasetGenerator(const DatasetGenerator&) = delete;
+    DatasetGenerator& operator=(const DatasetGenerator&) = delete;
+
+    // Plays until the file holds total_records records (a replay buffer: until total_records were pushed) or
+    // stop() is called, returns the records in the file (pushed)
+    uint64_t run(uint64_t total_records);
+
+    // Makes a running run() return after the current moves, the finished records are still written
+    void stop() {
+        stopping.store(true);
+    }
+
+    // Progress counters, can be read while run() is working
+    uint64_t records() const {
+        return records_written.load();
+    }
+
+    uint64_t games() const {
+        return games_finished.load();
+    }
+
+    const std::string& path() const {
+        return file_path;
+    }
+
+private:
+    void play(uint64_t total_records, uint64_t run_seed);
+    void append(std::vector<SelfPlayRecord>& chunk);
+
+    std::string file_path;
+    int samples;
+    int depth;
+    int policy;
+    size_t chunk_records;
+
+    std::unique_ptr<RecordWriter> writer;
+    std::shared_ptr<ReplayBuffer> buffer;
+    std::mutex file_mutex;
+    std::atomic<uint64_t> records_reserved{0};
+    std::atomic<uint64_t> records_written{0};
+    std::atomic<uint64_t> games_started{0};
+    std::atomic<uint64_t> games_finished{0};
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> write_failed{false};
+};
+
+#endif // DATASETGENERATOR_H
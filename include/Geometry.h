@@ -0,0 +1,581 @@
+#ifndef GEOMETRY_H
+#define GEOMETRY_H
+
+#include "game.h"
+#include "tables.h"
+#include "policies.h"
+#include "Random.h"
+#include "ThreadPool.h"
+#include "TranspositionTable.h"
+#include "Stats.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Board geometries other than the 4x4 board of 4 bit cells. a geometry is a square board of Rows x Cols
+// cells of CellBits bits (the exponent of the tile, 0 for an empty cell) in the smallest unsigned integer
+// that holds it, 64 or 128 bits, cell row*Cols+col at bits CellBits*(row*Cols+col). the moves, spawns,
+// policies, rollouts and the expectimax search below are templates on the geometry, instantiated once
+// per geometry.
+// GeometryGame<Geometry<4, 4, 4>> is the engine itself (tables.h), so the default board keeps its tables
+// and transposes; the other geometries move a row or column with one lookup in a row table, filled on
+// first use. tiles of the largest exponent a cell holds do not merge: 32768 on 4 bit cells, 2^31 on 5 bit
+
+template <int Rows, int Cols, int CellBits>
+struct Geometry {
+    static_assert(Rows == Cols, "columns are moved with the row tables, so the board must be square");
+    static_assert(Cols * CellBits <= 20, "a row indexes the row table, at most 2^20 entries");
+    static_assert(Rows * Cols * CellBits <= 128, "a board is at most 128 bits");
+
+    static constexpr int rows = Rows;
+    static constexpr int cols = Cols;
+    static constexpr int cell_bits = CellBits;
+    static constexpr int cells = Rows * Cols;
+    static constexpr int row_bits = Cols * CellBits;
+    static constexpr uint32_t cell_mask = (1u << CellBits) - 1;
+    static constexpr uint32_t row_mask = (1u << row_bits) - 1;
+    static constexpr unsigned max_exponent = cell_mask;
+
+    using Board = std::conditional_t<(cells * CellBits <= 64), uint64_t, unsigned __int128>;
+};
+
+using DefaultGeometry = Geometry<4, 4, 4>;
+
+// Moves, spawns and successors of a geometry, the interface the policies and rollouts below are written against
+template <typename G>
+struct GeometryGame {
+    using Board = typename G::Board;
+
+    static constexpr int cells = G::cells;
+
+    struct Successors {
+        Board board;
+        Board boards[4];
+        uint64_t scores[4];
+        unsigned legal;
+    };
+
+    // Row after moving left and the merge score / 4 (multiples of 4, at most 2 * 2^31 on 5 bit cells)
+    struct RowMove {
+        uint32_t row;
+        uint32_t quarter_score;
+    };
+
+    static unsigned cell(Board board, int i) {
+        return (unsigned)(board >> (i * G::cell_bits)) & G::cell_mask;
+    }
+
+    static unsigned count_empty(Board board) {
+        unsigned count = 0;
+        for (int i = 0; i < G::cells; ++i) count += cell(board, i) == 0;
+        return count;
+    }
+
+    static Board with_tile(Board board, int i, unsigned rank) {
+        return board | ((Board)rank << (i * G::cell_bits));
+    }
+
+    static const RowMove* row_table() {
+        static const std::vector<RowMove> table = fill_row_table();
+        return table.data();
+    }
+
+    // The table evaluator of heuristics.h on every row and column, with a row table of its own
+    static double evaluate(Board board) {
+        static const std::vector<float> table = fill_row_scores();
+        double score = 0;
+        for (int i = 0; i < G::rows; ++i) {
+            score += table[(uint32_t)(board >> (i * G::row_bits)) & G::row_mask];
+            score += table[get_column(board, i)];
+        }
+        return score;
+    }
+
+    // Transposition table key, a 128 bit board is folded into 64 bits: two boards share a key with a
+    // chance of about 2^-64, the symmetries of a board are not merged
+    static uint64_t key(Board board) {
+        if constexpr (sizeof(Board) == sizeof(uint64_t)) return board;
+        else return (uint64_t)board ^ ((uint64_t)(board >> 64) * 0x9E3779B97F4A7C15ULL);
+    }
+
+    static TranspositionTable& expectimax_table() {
+        static TranspositionTable table(20);
+        return table;
+    }
+
+    static Successors successors(Board board) {
+        const RowMove* table = row_table();
+        Successors s = {};
+        s.board = board;
+        for (int i = 0; i < G::rows; ++i) {
+            //rows move left, or right on the reversed row, columns up and down the same way
+            const uint32_t row = (uint32_t)(board >> (i * G::row_bits)) & G::row_mask;
+            const uint32_t column = get_column(board, i);
+            const RowMove moves[4] = {table[row], table[reverse_row(row)], table[column], table[reverse_row(column)]};
+            s.boards[0] |= (Board)moves[0].row << (i * G::row_bits);
+            s.boards[1] |= (Board)reverse_row(moves[1].row) << (i * G::row_bits);
+            s.boards[2] |= put_column(moves[2].row, i);
+            s.boards[3] |= put_column(reverse_row(moves[3].row), i);
+            for (int d = 0; d < 4; ++d) s.scores[d] += moves[d].quarter_score;
+        }
+        for (int d = 0; d < 4; ++d) {
+            s.scores[d] <<= 2;
+            s.legal |= (unsigned)(s.boards[d] != board) << d;
+        }
+        return s;
+    }
+
+    // Adds a 2 (90%) or a 4 (10%) on a random empty cell, with the single draw of spawn_tile
+    static Board spawn(Board board, Rng& rng) {
+        const unsigned empty = count_empty(board);
+        if (empty == 0) return board;
+        const uint64_t r = rng.next64();
+        uint32_t k = (uint32_t)(((r & 0xFFFFFFFF) * (uint64_t)empty) >> 32);
+        const Board new_tile = ((r >> 32) < 429496730u) ? 2 : 1;
+        for (int i = 0; i < G::cells; ++i) {
+            if (cell(board, i) != 0) continue;
+            if (k-- == 0) return board | (new_tile << (i * G::cell_bits));
+        }
+        return board;
+    }
+
+private:
+    static uint32_t reverse_row(uint32_t row) {
+        uint32_t reversed = 0;
+        for (int i = 0; i < G::cols; ++i) {
+            reversed |= ((row >> (i * G::cell_bits)) & G::cell_mask) << ((G::cols - 1 - i) * G::cell_bits);
+        }
+        return reversed;
+    }
+
+    // Column c as a row, the top cell first
+    static uint32_t get_column(Board board, int c) {
+        uint32_t column = 0;
+        for (int r = 0; r < G::rows; ++r) column |= cell(board, r * G::cols + c) << (r * G::cell_bits);
+        return column;
+    }
+
+    static Board put_column(uint32_t column, int c) {
+        Board board = 0;
+        for (int r = 0; r < G::rows; ++r) {
+            board |= (Board)((column >> (r * G::cell_bits)) & G::cell_mask) << ((r * G::cols + c) * G::cell_bits);
+        }
+        return board;
+    }
+
+    static std::vector<RowMove> fill_row_table() {
+        std::vector<RowMove> table((size_t)1 << G::row_bits);
+        for (uint32_t row = 0; row < table.size(); ++row) {
+            unsigned tiles[G::cols];
+            int n = 0;
+            for (int i = 0; i < G::cols; ++i) {
+                const unsigned tile = (row >> (i * G::cell_bits)) & G::cell_mask;
+                if (tile != 0) tiles[n++] = tile;
+            }
+            uint32_t result = 0;
+            uint64_t score = 0;
+            int out = 0;
+            for (int i = 0; i < n; ++i) {
+                unsigned tile = tiles[i];
+                if (i + 1 < n && tiles[i + 1] == tile && tile < G::max_exponent) {
+                    tile++;
+                    score += 1ULL << tile;
+                    i++;
+                }
+                result |= tile << (out++ * G::cell_bits);
+            }
+            table[row] = {result, (uint32_t)(score >> 2)};
+        }
+        return table;
+    }
+
+    static std::vector<float> fill_row_scores() {
+        std::vector<float> table((size_t)1 << G::row_bits);
+        for (uint32_t row = 0; row < table.size(); ++row) {
+            int rank[G::cols];
+            for (int i = 0; i < G::cols; ++i) rank[i] = (int)((row >> (i * G::cell_bits)) & G::cell_mask);
+            table[row] = (float)row_features(rank, G::cols).score;
+        }
+        return table;
+    }
+};
+
+// The engine's expectimax cache, expectimax.cpp
+extern TranspositionTable expectimax_table;
+
+// The 4x4 board of 4 bit cells is the engine's own board, with its move tables, spawn, evaluators and
+// transposition table. its table key is the canonical board, all 8 symmetries share an entry
+template <>
+struct GeometryGame<DefaultGeometry> {
+    using Board = uint64_t;
+    using Successors = ::Successors;
+
+    static constexpr int cells = 16;
+
+    static unsigned cell(Board board, int i) {
+        return (unsigned)(board >> (i * 4)) & 0xF;
+    }
+
+    static unsigned count_empty(Board board) {
+        return (unsigned)__builtin_popcountll(empty_cells(board));
+    }
+
+    static Successors successors(Board board) {
+        return ::successors(board);
+    }
+
+    static Board spawn(Board board, Rng& rng) {
+        return spawn_tile(board, rng);
+    }
+
+    static Board with_tile(Board board, int i, unsigned rank) {
+        return board | ((Board)rank << (i * 4));
+    }
+
+    // The n-tuple network if one is set (it values afterstates, which the leaves below a move are), else
+    // the table evaluator
+    static double evaluate(Board board) {
+        const NTupleNetwork* network = ntuple_network();
+        return network ? network->evaluate(board) : evaluate_board(board);
+    }
+
+    static uint64_t key(Board board) {
+        return canonical_board(board).board;
+    }
+
+    static TranspositionTable& expectimax_table() {
+        return ::expectimax_table;
+    }
+};
+
+// Geometry rollout policies. the policy numbers are those of PolicyList, the policies only the geometries
+// have come after n_policies, see GeometryPolicies
+
+// Policy 9 (max_merge_policy). highest merge score, ties to the first move
+struct MaxMergePolicy {
+    template <typename Game>
+    static unsigned choose(const typename Game::Successors& next, Rng&) {
+        unsigned best_direction = 4;
+        for (unsigned direction = 0; direction < 4; ++direction) {
+            if (!(next.legal & (1u << direction))) continue;
+            if (best_direction == 4 || next.scores[direction] > next.scores[best_direction]) best_direction = direction;
+        }
+        return best_direction;
+    }
+};
+
+// Policy 1. most empty cells, MostEmptyPolicy on any geometry
+struct GeometryMostEmptyPolicy {
+    template <typename Game>
+    static unsigned choose(const typename Game::Successors& next, Rng&) {
+        unsigned highest_score = 0;
+        unsigned best_direction = 4;
+        for (unsigned direction = 0; direction < 4; ++direction) {
+            if (!(next.legal & (1u << direction))) continue;
+            const unsigned score = Game::count_empty(next.boards[direction]);
+            if (best_direction == 4 || score > highest_score) {
+                highest_score = score;
+                best_direction = direction;
+            }
+        }
+        return best_direction;
+    }
+};
+
+// Policy 2. the first possible direction, also the fallback for unknown policies
+struct GeometryFirstMovePolicy {
+    template <typename Game>
+    static unsigned choose(const typename Game::Successors& next, Rng&) {
+        return first_move(next.legal);
+    }
+};
+
+// Policy 3. a random direction
+struct GeometryRandomPolicy {
+    template <typename Game>
+    static unsigned choose(const typename Game::Successors& next, Rng& rng) {
+        return random_move(next.legal, rng);
+    }
+};
+
+// A policy of PolicyList on the default board, whose successors are the engine's
+template <typename Policy>
+struct EnginePolicy {
+    template <typename Game>
+    static unsigned choose(const typename Game::Successors& next, Rng& rng) {
+        return Policy::choose(next, rng);
+    }
+};
+
+constexpr int max_merge_policy = n_policies;
+constexpr int n_geometry_policies = n_policies + 1;
+
+// The policies of a game by number. the other geometries have policies 1-3 and 9, the rest need the 4x4
+// row tables or the networks and play the fallback policy 2 like an unknown number
+template <typename Game>
+struct GeometryPolicies {
+    using List = std::tuple<
+        GeometryFirstMovePolicy,    // 0, min adjacent difference
+        GeometryMostEmptyPolicy,
+        GeometryFirstMovePolicy,
+        GeometryRandomPolicy,
+        GeometryFirstMovePolicy,    // 4, sampled min adjacent difference
+        GeometryFirstMovePolicy,    // 5, greedy evaluation
+        GeometryFirstMovePolicy,    // 6, sampled evaluation
+        GeometryFirstMovePolicy,    // 7, policy network
+        GeometryFirstMovePolicy,    // 8, n-tuple network
+        MaxMergePolicy>;
+};
+
+// The default board has every policy of PolicyList, then the geometry policies
+template <>
+struct GeometryPolicies<GeometryGame<DefaultGeometry>> {
+    template <size_t... I>
+    static auto engine_policies(std::index_sequence<I...>)
+        -> std::tuple<EnginePolicy<std::tuple_element_t<I, PolicyList>>..., MaxMergePolicy>;
+
+    using List = decltype(engine_policies(std::make_index_sequence<n_policies>{}));
+};
+
+static_assert(std::tuple_size<GeometryPolicies<GeometryGame<Geometry<3, 3, 4>>>::List>::value == n_geometry_policies,
+              "a policy of PolicyList is missing in GeometryPolicies");
+static_assert(std::tuple_size<GeometryPolicies<GeometryGame<DefaultGeometry>>::List>::value == n_geometry_policies,
+              "the default board numbers its policies like PolicyList");
+
+// Picks a move, expects at least one legal move
+template <typename Game, typename Policy>
+inline unsigned geometry_choose(const typename Game::Successors& next, Rng& rng) {
+    if ((next.legal & (next.legal - 1)) == 0) return first_move(next.legal);
+    return Policy::template choose<Game>(next, rng);
+}
+
+// Plays up to depth moves from board and returns the merge score collected on the way
+template <typename Game, typename Policy>
+inline double geometry_play_out(typename Game::Board board, int depth, Rng& rng) {
+    double score = 0;
+    for (int k = 0; k < depth; ++k) {
+        const typename Game::Successors next = Game::successors(board);
+        if (next.legal == 0) break; //game over
+        const unsigned direction = geometry_choose<Game, Policy>(next, rng);
+        score += (double)next.scores[direction];
+        board = Game::spawn(next.boards[direction], rng);
+    }
+    return score;
+}
+
+// Fn::run<Policy> for every policy of the game, unknown policy numbers fall back to default_policy
+template <typename Game, typename Fn, size_t... I>
+inline auto geometry_policy_entry(int policy, std::index_sequence<I...>) {
+    using List = typename GeometryPolicies<Game>::List;
+    using Entry = decltype(&Fn::template run<std::tuple_element_t<0, List>>);
+    static constexpr std::array<Entry, sizeof...(I)> table = {{&Fn::template run<std::tuple_element_t<I, List>>...}};
+    return table[(policy >= 0 && policy < n_geometry_policies) ? policy : default_policy];
+}
+
+template <typename Game, typename Fn>
+inline auto geometry_policy_entry(int policy) {
+    return geometry_policy_entry<Game, Fn>(policy, std::make_index_sequence<n_geometry_policies>{});
+}
+
+template <typename Game>
+struct GeometryRolloutSum {
+    template <typename Policy>
+    static double run(typename Game::Board base_board, uint64_t base_score, int depth, int count, Rng& rng) {
+        double sum = 0;
+        for (int j = 0; j < count; ++j) {
+            sum += (double)base_score + geometry_play_out<Game, Policy>(Game::spawn(base_board, rng), depth, rng);
+        }
+        return sum;
+    }
+};
+
+template <typename Game>
+struct GeometryChooseMove {
+    template <typename Policy>
+    static unsigned run(const typename Game::Successors& next, Rng& rng) {
+        return geometry_choose<Game, Policy>(next, rng);
+    }
+};
+
+// Sum of samples rollout returns of every move, 0 for moves that are not possible and for the moves of a
+// board with a single possible move. the rollouts are split into chunks on the rollout pool, each with its
+// own rng stream from the generator of the calling thread, like compute_scores
+template <typename G>
+std::array<double, 4> geometry_scores(typename G::Board board, int samples, int depth, int policy) {
+    using Game = GeometryGame<G>;
+    constexpr int chunk_size = 32;
+    std::array<double, 4> scores = {0, 0, 0, 0};
+    const typename Game::Successors next = Game::successors(board);
+    if ((next.legal & (next.legal - 1)) == 0 || samples <= 0) return scores;
+
+    const int chunks = (samples + chunk_size - 1) / chunk_size;
+    const uint64_t call_seed = thread_rng().next64();
+    const auto rollout_sum = geometry_policy_entry<Game, GeometryRolloutSum<Game>>(policy);
+    std::vector<double> partial(4 * (size_t)chunks, 0.0);
+    get_rollout_pool().parallel_for(partial.size(), [&](size_t task) {
+        const unsigned direction = (unsigned)(task / chunks);
+        if (!(next.legal & (1u << direction))) return;
+        const int begin = (int)(task % chunks) * chunk_size;
+        const int end = std::min(samples, begin + chunk_size);
+        seed_thread_rng(call_seed, task);
+        partial[task] = rollout_sum(next.boards[direction], next.scores[direction], depth, end - begin, thread_rng());
+    });
+    for (unsigned direction = 0; direction < 4; ++direction) {
+        for (int c = 0; c < chunks; ++c) scores[direction] += partial[direction * chunks + c];
+    }
+    return scores;
+}
+
+// Best move by geometry_scores, 0 on a finished game
+template <typename G>
+unsigned geometry_best_move(typename G::Board board, int samples, int depth, int policy) {
+    const unsigned legal = GeometryGame<G>::successors(board).legal;
+    if (legal == 0) return 0;
+    if ((legal & (legal - 1)) == 0) return first_move(legal);
+    const std::array<double, 4> scores = geometry_scores<G>(board, samples, depth, policy);
+    unsigned best_direction = first_move(legal);
+    for (unsigned direction = 0; direction < 4; ++direction) {
+        if ((legal & (1u << direction)) && scores[direction] > scores[best_direction]) best_direction = direction;
+    }
+    return best_direction;
+}
+
+// Expectimax search on a game, the engine's compute_expectimax_scores is the default board's. max nodes
+// pick the best move, chance nodes average over every 2/4 spawn weighted by its probability, a node is
+// scored by Game::evaluate once the depth limit is reached or once the probability of reaching it drops
+// below min_probability. chance node values are cached in Game::expectimax_table under Game::key and the
+// remaining depth. the spawns of the root chance nodes are spread over the rollout pool
+template <typename Game>
+struct GeometryExpectimax {
+    using Board = typename Game::Board;
+
+    // Inlined into max_node, the search recurses through max_node alone. left to the compiler, max_node
+    // is inlined into chance_node instead and the search is about 15% slower
+    __attribute__((always_inline)) static double chance_node(Board board, int depth, double probability, double min_probability) {
+        if (depth <= 0 || probability < min_probability) return Game::evaluate(board);
+        //a deep search is stopped here, not only between the root spawns (see SearchService)
+        ThreadPool::check_interrupt();
+
+        TranspositionTable& table = Game::expectimax_table();
+        const uint64_t key = Game::key(board);
+        float cached;
+        STAT_ADD(STAT_TABLE_PROBES, 1);
+        if (table.probe(key, depth, cached)) {
+            STAT_ADD(STAT_TABLE_HITS, 1);
+            return cached;
+        }
+        STAT_ADD(STAT_EXPECTIMAX_NODES, 1);
+
+        const unsigned empty = Game::count_empty(board);
+        double value = 0;
+        for (int i = 0; i < Game::cells; ++i) {
+            if (Game::cell(board, i) != 0) continue;
+            value += 0.9 * max_node(Game::with_tile(board, i, 1), depth, probability * 0.9 / empty, min_probability);
+            value += 0.1 * max_node(Game::with_tile(board, i, 2), depth, probability * 0.1 / empty, min_probability);
+        }
+        value /= empty;
+
+        table.store(key, depth, (float)value);
+        return value;
+    }
+
+    static double max_node(Board board, int depth, double probability, double min_probability) {
+        const typename Game::Successors next = Game::successors(board);
+        double best = 0; //no move left: the game ends and scores nothing more
+        for (int direction = 0; direction < 4; ++direction) {
+            if (!(next.legal & (1u << direction))) continue;
+            best = std::max(best, next.scores[direction] + chance_node(next.boards[direction], depth - 1, probability, min_probability));
+        }
+        return best;
+    }
+
+    // Value of every move, 0 for moves that are not possible
+    static std::array<double, 4> scores(Board board, int depth, double min_probability) {
+        Game::expectimax_table().new_search();
+
+        struct RootSpawn {
+            int move;
+            int cell;
+        };
+        const typename Game::Successors next = Game::successors(board);
+        std::vector<RootSpawn> spawns;
+        for (int direction = 0; direction < 4; ++direction) {
+            if (!(next.legal & (1u << direction)) || depth <= 1) continue;
+            for (int i = 0; i < Game::cells; ++i) {
+                if (Game::cell(next.boards[direction], i) == 0) spawns.push_back({direction, i});
+            }
+        }
+
+        std::vector<double> spawn_values(spawns.size(), 0.0);
+        get_rollout_pool().parallel_for(spawns.size(), [&](size_t task) {
+            const Board afterstate = next.boards[spawns[task].move];
+            const int cell = spawns[task].cell;
+            const double empty = Game::count_empty(afterstate);
+            spawn_values[task] = 0.9 * max_node(Game::with_tile(afterstate, cell, 1), depth - 1, 0.9 / empty, min_probability)
+                               + 0.1 * max_node(Game::with_tile(afterstate, cell, 2), depth - 1, 0.1 / empty, min_probability);
+        });
+
+        std::array<double, 4> scores = {0, 0, 0, 0};
+        for (int direction = 0; direction < 4; ++direction) {
+            if (!(next.legal & (1u << direction))) continue;
+            if (depth <= 1) {
+                scores[direction] = next.scores[direction] + Game::evaluate(next.boards[direction]);
+                continue;
+            }
+            double value = 0;
+            for (size_t t = 0; t < spawns.size(); ++t) {
+                if (spawns[t].move == direction) value += spawn_values[t];
+            }
+            scores[direction] = next.scores[direction] + value / Game::count_empty(next.boards[direction]);
+        }
+        return scores;
+    }
+};
+
+// Best move by the expectimax search, 0 on a finished game
+template <typename G>
+unsigned geometry_expectimax_move(typename G::Board board, int depth, double min_probability) {
+    const unsigned legal = GeometryGame<G>::successors(board).legal;
+    if (legal == 0) return 0;
+    if ((legal & (legal - 1)) == 0) return first_move(legal);
+    const std::array<double, 4> scores = GeometryExpectimax<GeometryGame<G>>::scores(board, depth, min_probability);
+    unsigned best_direction = first_move(legal);
+    for (unsigned direction = 0; direction < 4; ++direction) {
+        if ((legal & (1u << direction)) && scores[direction] > scores[best_direction]) best_direction = direction;
+    }
+    return best_direction;
+}
+
+// The geometries the library is built for, behind one board type wide enough for all of them, so that
+// the tools and the python module can pick a geometry at run time. "4x4x4" is the default board
+using WideBoard = unsigned __int128;
+
+struct GeometryFunctions {
+    const char* name;
+    int size;
+    int cell_bits;
+    WideBoard (*new_game)();
+    std::pair<WideBoard, uint64_t> (*move)(WideBoard board, int direction);  // board after the move and its merge score, a
+                                                                             // direction other than 0-3 leaves the board as it is
+    WideBoard (*add_new_tile)(WideBoard board);
+    unsigned (*legal_moves)(WideBoard board);                                // bit d for direction d
+    std::array<double, 4> (*scores)(WideBoard board, int samples, int depth, int policy);
+    unsigned (*best_move)(WideBoard board, int samples, int depth, int policy);
+    std::array<double, 4> (*expectimax_scores)(WideBoard board, int depth, double min_probability);
+    unsigned (*expectimax_move)(WideBoard board, int depth, double min_probability);
+    unsigned (*policy_move)(WideBoard board, int policy);
+    uint64_t (*max_tile)(WideBoard board);
+};
+
+// Throws std::invalid_argument for a geometry the library is not built for
+const GeometryFunctions& geometry_functions(const std::string& name);
+
+std::vector<std::string> geometry_names();
+
+#endif // GEOMETRY_H
@@ -0,0 +1,74 @@
+#ifndef MCTS_H
+#define MCTS_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Monte-Carlo tree search with UCT selection. the tree alternates decision nodes (the board before
+// our move) and chance nodes (the board after the move, before the spawn). chance nodes grow one
+// child per spawn outcome that was sampled. all nodes live in a fixed-size arena and link to each
+// other by index. when a later search starts from a board that is in the tree, that subtree is
+// copied to the front of a second arena and kept, together with its statistics
+class MCTS {
+public:
+    MCTS(size_t capacity, double exploration, int rollout_depth, int policy);
+
+    // Runs the given number of iterations from board and returns the most visited move
+    unsigned search(uint64_t board, int iterations);
+
+    struct TimedResult {
+        unsigned move;
+        uint64_t iterations;
+        double elapsed_us;
+    };
+
+    // Runs iterations from board until budget_us microseconds have passed, the clock is read before every
+    // iteration. returns the most visited move and the iterations that fit in the budget
+    TimedResult search_for(uint64_t board, int64_t budget_us);
+
+    void reset();
+
+    size_t size() const {
+        return nodes.size();
+    }
+
+    size_t capacity() const {
+        return max_nodes;
+    }
+
+    // Statistics of the root moves, 0 for moves that are not possible
+    std::vector<unsigned> root_visits() const;
+    std::vector<double> root_values() const;
+
+private:
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+    struct Node {
+        uint64_t board;
+        double value_sum;      // sum of the returns of the iterations through this node
+        uint32_t visits;
+        uint32_t first_child;
+        uint32_t next_sibling;
+        uint32_t reward;       // chance nodes: merge score of the move that leads here
+        uint8_t move;          // chance nodes: the move that leads here
+        bool expanded;
+    };
+
+    uint32_t allocate(uint64_t board);
+    void set_root(uint64_t board);
+    uint32_t select_move(uint32_t node) const;
+    double rollout(uint64_t board) const;
+    void iterate();
+    unsigned most_visited_move() const;
+
+    std::vector<Node> nodes;
+    std::vector<Node> spare;   // second arena, target of the subtree copy
+    size_t max_nodes;
+    double exploration;
+    int rollout_depth;
+    int policy;
+    uint32_t root = NONE;
+};
+
+#endif // MCTS_H
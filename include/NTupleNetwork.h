@@ -0,0 +1,90 @@
+#ifndef NTUPLENETWORK_H
+#define NTUPLENETWORK_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Successors;
+
+// N-tuple network: a value function of afterstates (the board after a move, before the spawn). every
+// tuple is a pattern of 6 cells whose tile exponents index a table of 16^6 weights, the value is the sum
+// of the weights of every tuple over all 8 rotations and reflections of the board. the default tuples are
+// the two L-shaped (a row of 4 and the 2 cells below its start) and two 2x3 rectangle tuples of Szubert
+// and Jaskowski, 4 tables of 64 MB.
+//
+// training is TD(0) on afterstates: every thread plays games greedily on reward + value of the afterstate
+// and moves the value of the previous afterstate towards the reward plus the value of the next one.
+// the threads update the shared tables without locks, through relaxed atomic loads and stores of the
+// weights. a lost update now and then does not matter
+//
+// weight file, little endian: "M2048NTN", uint32 version (1), uint32 number of tuples, uint32 tuple size,
+// the cells of every tuple as uint8, then every table as runs: uint32 zeros, uint32 count, count float32
+// weights, until the table is full. unvisited patterns stay 0, so the runs keep the file small
+class NTupleNetwork {
+public:
+    static constexpr int tuple_size = 6;
+    using Tuple = std::array<uint8_t, tuple_size>;
+
+    NTupleNetwork();
+    explicit NTupleNetwork(const std::vector<Tuple>& tuples);
+
+    // Loads a weight file, throws std::runtime_error
+    explicit NTupleNetwork(const std::string& path);
+
+    // Writes the weight file, throws std::runtime_error
+    void save(const std::string& path) const;
+
+    // Value of an afterstate
+    float evaluate(uint64_t afterstate) const;
+
+    // Adds delta to the value of an afterstate, spread evenly over all its weights
+    void update(uint64_t afterstate, float delta);
+
+    // The legal move with the highest merge score + afterstate value, expects at least one legal move
+    unsigned best_move(const Successors& next) const;
+
+    struct TrainingResult {
+        uint64_t games;
+        double mean_score;
+        uint64_t max_score;
+    };
+
+    // Trains on games of self-play on the rollout pool, learning_rate is the step of the whole value
+    TrainingResult train(uint64_t games, float learning_rate);
+
+    // Games finished by the running train(), for progress reports
+    uint64_t games_trained() const {
+        return trained_games.load();
+    }
+
+    const std::vector<Tuple>& get_tuples() const {
+        return tuples;
+    }
+
+private:
+    float* table(size_t tuple) {
+        return weights.data() + tuple * table_size;
+    }
+
+    const float* table(size_t tuple) const {
+        return weights.data() + tuple * table_size;
+    }
+
+    static constexpr size_t table_size = size_t(1) << (4 * tuple_size);
+
+    std::vector<Tuple> tuples;
+    std::vector<float> weights;
+    std::atomic<uint64_t> trained_games{0};
+};
+
+// The n-tuple network used as the leaf value of the expectimax search and by policy 8, none by default.
+// setting it clears the expectimax table, must not happen while a search is running
+void set_ntuple_network(std::shared_ptr<NTupleNetwork> network);
+const NTupleNetwork* ntuple_network();
+
+#endif // NTUPLENETWORK_H
@@ -0,0 +1,72 @@
+#ifndef NETWORK_H
+#define NETWORK_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Dense network (Linear, SiLU, ..., Linear) as trained by train.py, evaluated natively. the weight file
+// is written by export_network in train.py, little endian:
+//
+//   char[8]   "M2048MLP"
+//   uint32    version (1)
+//   uint32    number of linear layers L
+//   uint32    L + 1 layer widths, input first
+//   float32   per layer: weight[out][in] (torch layout), then bias[out]
+//
+// the weights are kept transposed and padded to 8 outputs, so a layer is a row of fused multiply-adds
+// over 8 outputs at a time. forward() runs the samples through every layer in blocks of 4, every weight
+// it loads is used for the whole block. the AVX2/FMA kernel is picked at runtime
+class Network {
+public:
+    // Loads a weight file, throws std::runtime_error
+    explicit Network(const std::string& path);
+
+    size_t input_size() const {
+        return layers.front().in;
+    }
+
+    size_t output_size() const {
+        return layers.back().out;
+    }
+
+    // outputs[i * output_size() + k] for the inputs[i * input_size() ...] of n samples
+    void forward(const float* inputs, float* outputs, size_t n) const;
+
+private:
+    struct Layer {
+        size_t in;
+        size_t out;
+        size_t out_padded;
+        std::vector<float> weights;   // [in][out_padded]
+        std::vector<float> bias;      // [out_padded]
+    };
+
+    std::vector<Layer> layers;
+    size_t max_width = 0;
+};
+
+// The 56 input features of one board, see extract_features
+void board_features(uint64_t board, float* out);
+
+// The networks the engine uses: a policy network with 4 outputs, one per move, trained on the move
+// scores as in train.py, and an optional value network with 1 output that scores the board at the end
+// of a truncated rollout. loading must not happen while a search is running
+void load_policy_network(const std::string& path);
+void load_value_network(const std::string& path);
+void clear_networks();
+const Network* policy_network();
+const Network* value_network();
+
+// Name of the network kernel picked for this CPU
+const char* network_kernel_name();
+
+// Policy network move of every board, 0 for finished boards. throws if no policy network is loaded
+void network_best_moves(const uint64_t* boards, int32_t* actions, size_t n);
+
+// Sum of samples rollouts of depth moves per move with the policy network, plus the value network at the
+// end of the rollout if one is loaded. 0 for moves that are not possible, like py_compute_scores
+std::vector<double> compute_network_scores(const uint64_t board, const int samples, const int depth);
+
+#endif // NETWORK_H
@@ -0,0 +1,171 @@
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <cstdint>
+
+// Small, fast generators for the rollouts. all have the same interface, the one the engine uses is
+// picked at compile time with Rng below. seed(seed, stream) gives every (seed, stream) pair its own
+// sequence, so threads and rollout chunks can draw from independent, reproducible streams
+
+inline uint64_t splitmix64(uint64_t& state) {
+    uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// xoshiro256** by Blackman and Vigna
+class Xoshiro256 {
+public:
+    explicit Xoshiro256(uint64_t seed_value = 0, uint64_t stream = 0) {
+        seed(seed_value, stream);
+    }
+
+    void seed(uint64_t seed_value, uint64_t stream) {
+        uint64_t state = seed_value ^ splitmix64(stream);
+        for (auto& word : s) word = splitmix64(state);
+    }
+
+    uint64_t next64() {
+        const uint64_t result = rotl(s[1] * 5, 7) * 9;
+        const uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    uint32_t next32() {
+        return (uint32_t)(next64() >> 32);
+    }
+
+private:
+    static uint64_t rotl(uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    uint64_t s[4];
+};
+
+// PCG32 (XSH-RR) by O'Neill, the stream selects the increment
+class Pcg32 {
+public:
+    explicit Pcg32(uint64_t seed_value = 0, uint64_t stream = 0) {
+        seed(seed_value, stream);
+    }
+
+    void seed(uint64_t seed_value, uint64_t stream) {
+        inc = (stream << 1) | 1;
+        state = 0;
+        next32();
+        state += seed_value;
+        next32();
+    }
+
+    uint32_t next32() {
+        const uint64_t old = state;
+        state = old * 6364136223846793005ULL + inc;
+        const uint32_t xorshifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+        const uint32_t rot = (uint32_t)(old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    }
+
+    uint64_t next64() {
+        const uint64_t high = next32();
+        return (high << 32) | next32();
+    }
+
+private:
+    uint64_t state;
+    uint64_t inc;
+};
+
+// Squares64 by Widynski, a counter based generator: the n-th number of a stream is a hash of the stream's
+// key and n, so any draw of a stream can be computed directly and seek() is free. the paired rollouts
+// use it to give the same draw to the same step of the rollouts of different moves
+class Squares64 {
+public:
+    explicit Squares64(uint64_t seed_value = 0, uint64_t stream = 0) {
+        seed(seed_value, stream);
+    }
+
+    void seed(uint64_t seed_value, uint64_t stream) {
+        uint64_t state = seed_value ^ splitmix64(stream);
+        key = splitmix64(state) | 1;
+        counter = 0;
+    }
+
+    void seek(uint64_t position) {
+        counter = position;
+    }
+
+    uint64_t next64() {
+        const uint64_t y = counter++ * key;
+        const uint64_t z = y + key;
+        uint64_t x = y;
+        x = swap_halves(x * x + y);
+        x = swap_halves(x * x + z);
+        x = swap_halves(x * x + y);
+        const uint64_t t = x * x + z;
+        x = swap_halves(t);
+        return t ^ ((x * x + y) >> 32);
+    }
+
+    uint32_t next32() {
+        return (uint32_t)(next64() >> 32);
+    }
+
+private:
+    static uint64_t swap_halves(uint64_t x) {
+        return (x >> 32) | (x << 32);
+    }
+
+    uint64_t key;
+    uint64_t counter;
+};
+
+#ifdef MCTS2048_RNG_PCG
+using RngBase = Pcg32;
+#else
+using RngBase = Xoshiro256;
+#endif
+
+// The helpers the game needs on top of the raw bits of a generator
+template <typename Base>
+class RandomHelpers : public Base {
+public:
+    using Base::Base;
+
+    // Uniform in [0, n), multiply-shift instead of modulo
+    uint32_t bounded(uint32_t n) {
+        return (uint32_t)(((uint64_t)this->next32() * n) >> 32);
+    }
+
+    // Uniform in [0, 1)
+    double uniform() {
+        return (this->next64() >> 11) * 0x1.0p-53;
+    }
+};
+
+// The generator of the engine
+class Rng : public RandomHelpers<RngBase> {
+public:
+    using RandomHelpers<RngBase>::RandomHelpers;
+};
+
+// The counter based generator of the paired rollouts, see Squares64
+using CounterRng = RandomHelpers<Squares64>;
+
+// Generator of the calling thread. after set_seed every thread starts over from its own stream
+Rng& thread_rng();
+
+// Restarts the generator of the calling thread on the given stream of seed
+void seed_thread_rng(uint64_t seed, uint64_t stream);
+
+// Global seed. the calling thread continues on stream 0, other threads on streams 1, 2, ...
+void set_seed(uint64_t seed);
+
+#endif // RANDOM_H
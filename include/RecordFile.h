@@ -0,0 +1,125 @@
+#ifndef RECORDFILE_H
+#define RECORDFILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Self-play record files. the layout is fixed, little endian, and meant to be read in place (np.memmap,
+// see records.py, or RecordReader below):
+//
+//   offset 0                  RecordFileHeader, header_size bytes (64 in version 1)
+//   offset header_size        record 0, record_size bytes (32 in version 1)
+//   header_size + i * 32      record i
+//
+// record, 32 bytes:
+//   0   uint64   board     the board before the move, 16 nibbles, cell row*4+col at bits 4*(row*4+col)
+//   8   float32  scores[4] Monte-Carlo score of left, right, up, down, 0 for moves that are not possible
+//   24  uint8    move      the move that was played
+//   25  uint8    pad[3]    0
+//   28  uint32   reward    merge score of the move
+//
+// files are only ever appended to, so a file can be read while a generator is still writing it, and
+// several runs can be concatenated by appending their records behind one header. the record count is
+// not stored, it is (file size - header_size) / record_size
+
+struct SelfPlayRecord {
+    uint64_t board;
+    float scores[4];
+    uint8_t move;
+    uint8_t padding[3];
+    uint32_t reward;
+};
+
+static_assert(sizeof(SelfPlayRecord) == 32, "SelfPlayRecord must stay 32 bytes, it is the on-disk layout");
+
+constexpr char record_file_magic[8] = {'M', '2', '0', '4', '8', 'R', 'E', 'C'};
+constexpr uint32_t record_file_version = 1;
+
+struct RecordFileHeader {
+    char magic[8];          // "M2048REC"
+    uint32_t version;       // record_file_version
+    uint32_t header_size;   // offset of the first record
+    uint32_t record_size;   // sizeof(SelfPlayRecord)
+    int32_t samples;        // generator settings, -1 if unknown or mixed
+    int32_t depth;
+    int32_t policy;
+    uint8_t reserved[32];   // 0
+};
+
+static_assert(sizeof(RecordFileHeader) == 64, "RecordFileHeader must stay 64 bytes, it is the on-disk layout");
+
+// Appends records to a file. a new file gets a header with the given settings, an existing one is checked
+// and continued, a record at the end that was only partly written is cut off. throws std::runtime_error
+class RecordWriter {
+public:
+    RecordWriter(const std::string& path, int samples = -1, int depth = -1, int policy = -1);
+    ~RecordWriter();
+
+    RecordWriter(const RecordWriter&) = delete;
+    RecordWriter& operator=(const RecordWriter&) = delete;
+
+    // Appends and flushes n records. not thread-safe, callers serialize
+    void append(const SelfPlayRecord* records, size_t n);
+
+    // Number of records in the file
+    uint64_t size() const {
+        return n_records;
+    }
+
+    const RecordFileHeader& header() const {
+        return file_header;
+    }
+
+private:
+    std::FILE* file = nullptr;
+    std::string file_path;
+    RecordFileHeader file_header;
+    uint64_t n_records = 0;
+};
+
+// Read-only view of a record file through mmap, the records are not copied. throws std::runtime_error
+class RecordReader {
+public:
+    explicit RecordReader(const std::string& path);
+    ~RecordReader();
+
+    RecordReader(const RecordReader&) = delete;
+    RecordReader& operator=(const RecordReader&) = delete;
+
+    size_t size() const {
+        return n_records;
+    }
+
+    const SelfPlayRecord* data() const {
+        return records;
+    }
+
+    const SelfPlayRecord& operator[](size_t i) const {
+        return records[i];
+    }
+
+    const RecordFileHeader& header() const {
+        return file_header;
+    }
+
+    // Records [begin, end) of shard index out of count shards. shards are contiguous and differ in size by
+    // at most one record
+    std::pair<size_t, size_t> shard(size_t index, size_t count) const;
+
+private:
+    RecordFileHeader file_header;
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    const SelfPlayRecord* records = nullptr;
+    size_t n_records = 0;
+};
+
+// Writes the records of all inputs, in order, to output. the settings in the header are kept where all
+// inputs agree and -1 otherwise
+void concat_record_files(const std::string& output, const std::vector<std::string>& inputs);
+
+#endif // RECORDFILE_H
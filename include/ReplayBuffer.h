@@ -0,0 +1,92 @@
+#ifndef REPLAYBUFFER_H
+#define REPLAYBUFFER_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#include "RecordFile.h"
+
+// Replay buffer in POSIX shared memory, so that self-play workers (threads, or processes on the same host)
+// feed a trainer while it trains. a fixed ring of capacity self-play records (RecordFile.h): producers
+// push, the newest records overwrite the oldest, and samplers copy uniformly random records of the ring.
+// no locks: a push claims its slots with one fetch_add on the shared head, every slot has a sequence
+// number that is odd while the slot is written (a seqlock), and a sampler retries records whose sequence
+// changed while it copied them. a producer waits for a slot that another producer is still writing, and
+// takes it over only once that producer's process has died, which needs all producers in one pid
+// namespace. the segment layout, all little endian:
+//
+//   offset 0            ReplayBufferHeader, 128 bytes
+//   offset 128          capacity uint64 slot sequences: 0 empty, 2t+2 ticket t written, (pid << 1) | 1
+//                       being written by process pid
+//   128 + 8 * capacity  capacity records of 32 bytes
+//
+// the buffer that creates the segment removes its name when it is destroyed, processes that have it open
+// keep their mapping until they close it
+
+constexpr char replay_buffer_magic[8] = {'M', '2', '0', '4', '8', 'R', 'P', 'B'};
+constexpr uint32_t replay_buffer_version = 2;
+
+struct ReplayBufferHeader {
+    char magic[8];                  // "M2048RPB", written last by the creator
+    uint32_t version;               // replay_buffer_version
+    uint32_t record_size;           // sizeof(SelfPlayRecord)
+    uint64_t capacity;              // records, a power of two
+    uint8_t reserved[40];
+    std::atomic<uint64_t> head;     // records pushed so far, the next ticket; on its own cache line
+    uint8_t padding[56];
+};
+
+static_assert(sizeof(ReplayBufferHeader) == 128, "ReplayBufferHeader must stay 128 bytes, it is the shared layout");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "the shared counters must be lock free to work across processes");
+
+class ReplayBuffer {
+public:
+    // capacity > 0 creates the segment name (a leading / is added if missing) with capacity rounded up to a
+    // power of two, and fails if it exists. capacity 0 opens an existing segment. throws std::runtime_error
+    explicit ReplayBuffer(const std::string& name, size_t capacity = 0);
+    ~ReplayBuffer();
+
+    ReplayBuffer(const ReplayBuffer&) = delete;
+    ReplayBuffer& operator=(const ReplayBuffer&) = delete;
+
+    // Appends n records, overwriting the oldest ones once the ring is full. a slot that a producer a whole
+    // ring behind is still writing is waited for. thread and process safe
+    void push(const SelfPlayRecord* records, size_t n);
+
+    // Copies n records, drawn uniformly with replacement from the records in the ring, to out. returns the
+    // number copied: n, or 0 while the buffer is empty. thread and process safe
+    size_t sample(SelfPlayRecord* out, size_t n) const;
+
+    // Records pushed since the segment was created, by all producers
+    uint64_t pushed() const {
+        return header->head.load(std::memory_order_acquire);
+    }
+
+    // Records in the ring, at most capacity
+    size_t size() const;
+
+    size_t capacity() const {
+        return slots;
+    }
+
+    const std::string& name() const {
+        return segment_name;
+    }
+
+    // Removes the name of the segment now, instead of when the creating buffer is destroyed
+    void unlink();
+
+private:
+    std::string segment_name;
+    bool owner = false;
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    size_t slots = 0;
+    ReplayBufferHeader* header = nullptr;
+    std::atomic<uint64_t>* sequences = nullptr;
+    SelfPlayRecord* records = nullptr;
+};
+
+#endif // REPLAYBUFFER_H
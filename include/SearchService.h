@@ -0,0 +1,146 @@
+#ifndef SEARCHSERVICE_H
+#define SEARCHSERVICE_H
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Asynchronous searches for many concurrent games. jobs (a board and a search configuration) are queued
+// to a fixed set of worker threads and run on their own thread from start to end: inside a job the rollout
+// pool runs inline, so the service spreads games over the cores instead of the rollouts of one search.
+// every worker has its own queue, submit and submit_batch deal the jobs out round robin, and a worker
+// whose queue is empty steals from the others. a queued job is cancelled right away, a running one at the
+// next task of its search on the rollout pool (a chunk of rollouts) or, for expectimax, at its next chance
+// node, see ThreadPool::set_interrupt_flag. the policy search is a single step and always runs to its end.
+// every job draws from its own rng stream (service seed, job number), so a job's result only depends on
+// the seed of the service and the order of submission, not on which worker runs it
+
+struct SearchConfig {
+    std::string search = "mc";     // mc, adaptive, paired, timed, expectimax or policy
+    int samples = 1000;            // mc and paired: rollouts per move, adaptive: at most this many
+    int depth = 10;                // rollout depth, expectimax: search depth
+    int policy = 3;                // rollout policy, move policy of policy
+    double z = 2.0;                // adaptive: confidence bound in standard errors
+    int64_t budget_us = 1000;      // timed: time per search
+    double min_probability = 1e-4; // expectimax
+};
+
+struct SearchResult {
+    unsigned move = 0;
+    std::array<double, 4> scores{};  // per move: rollout sums (mc), mean returns (adaptive, paired, timed) or values (expectimax)
+    uint64_t work = 0;               // rollouts done, 0 for expectimax and policy
+    double elapsed_us = 0;
+};
+
+class SearchJob {
+public:
+    enum Status { PENDING, RUNNING, DONE, CANCELLED };
+
+    uint64_t board() const {
+        return job_board;
+    }
+
+    Status status() const {
+        return job_status.load();
+    }
+
+    bool done() const {
+        const Status s = status();
+        return s == DONE || s == CANCELLED;
+    }
+
+    // Cancels the job: a queued job right away, a running one once its search reaches its next task. returns
+    // whether the job ends cancelled, false if it was done already
+    bool cancel();
+
+    // Waits for the job. returns false if timeout_us passed first, a negative timeout waits forever
+    bool wait(int64_t timeout_us = -1) const;
+
+    // Waits for the job and returns its result, throws std::runtime_error if it was cancelled and
+    // rethrows the exception of a failed search
+    SearchResult result() const;
+
+    // Called once the job is done or cancelled, on the worker (or, if the job is already done, right away
+    // on the calling thread). a callback must not throw
+    void on_done(std::function<void(SearchJob&)> callback);
+
+private:
+    friend class SearchService;
+
+    SearchJob(uint64_t board, const SearchConfig& config, uint64_t number)
+        : job_board(board), config(config), number(number) {
+    }
+
+    void finish(Status final_status);
+
+    const uint64_t job_board;
+    const SearchConfig config;
+    const uint64_t number;
+    std::atomic<Status> job_status{PENDING};
+    std::atomic<bool> cancel_requested{false};   // set for a running job, its search checks it between tasks
+    SearchResult job_result;
+    std::exception_ptr error;
+    std::vector<std::function<void(SearchJob&)>> callbacks;
+    mutable std::mutex mutex;
+    mutable std::condition_variable cv;
+};
+
+class SearchService {
+public:
+    // n_threads <= 0 uses all cores
+    explicit SearchService(int n_threads = 0, uint64_t seed = 2048);
+
+    // Cancels the jobs that did not start and waits for the running ones
+    ~SearchService();
+
+    // Like the destructor, for callers that must not block in it (python holding the GIL). later submits
+    // throw, jobs of a submit that races with the shutdown end cancelled
+    void shutdown();
+
+    SearchService(const SearchService&) = delete;
+    SearchService& operator=(const SearchService&) = delete;
+
+    // Queues a search, throws std::invalid_argument for an unknown search
+    std::shared_ptr<SearchJob> submit(uint64_t board, const SearchConfig& config);
+    std::vector<std::shared_ptr<SearchJob>> submit_batch(const std::vector<uint64_t>& boards, const SearchConfig& config);
+
+    // Jobs in the queues, cancelled ones count until a worker drops them
+    size_t pending() const {
+        return n_pending.load();
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+private:
+    struct Worker {
+        std::deque<std::shared_ptr<SearchJob>> queue;
+        std::mutex mutex;
+    };
+
+    void worker_loop(size_t index);
+    std::shared_ptr<SearchJob> take(size_t index);
+    void run(SearchJob& job);
+
+    std::vector<std::unique_ptr<Worker>> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cv;
+    std::atomic<size_t> n_pending{0};
+    std::atomic<uint64_t> next_job{0};
+    std::atomic<bool> stopping{false};
+    const uint64_t seed;
+};
+
+#endif // SEARCHSERVICE_H
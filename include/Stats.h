@@ -0,0 +1,208 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+#ifndef MCTS2048_STATS
+#define MCTS2048_STATS 0
+#endif
+
+#if MCTS2048_STATS && defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+// Search instrumentation. compiled in with MCTS2048_STATS=1 (cmake -DMCTS2048_STATS=ON, or MCTS2048_STATS=1
+// in the environment of setup.py), otherwise RolloutStats and SearchLatency are empty and the hot loops
+// are the same as without them. every thread counts into its own counters, which are only summed up
+// when get_stats() is called. a rollout keeps its counts in registers and adds them once at its end.
+// the time split of a rollout step is measured with the cycle counter on every 16th rollout of a thread,
+// timing every step would cost more than the step itself
+
+enum StatCounter {
+    STAT_ROLLOUTS,              // rollouts played (compute_scores and friends, mcts)
+    STAT_ROLLOUT_STEPS,         // moves played in rollouts
+    STAT_ROLLOUT_GAME_OVERS,    // rollouts that ended on a finished game before their depth
+    STAT_TIMED_STEPS,           // rollout steps of the timed rollouts
+    STAT_MOVE_CYCLES,           // time of the timed steps in successors(), cycles
+    STAT_POLICY_CYCLES,         // time of the timed steps in the policy, cycles
+    STAT_SPAWN_CYCLES,          // time of the timed steps in spawn_tile, cycles
+    STAT_EXPECTIMAX_NODES,      // chance nodes searched
+    STAT_TABLE_PROBES,          // expectimax transposition table probes
+    STAT_TABLE_HITS,
+    STAT_MCTS_ITERATIONS,
+    n_stat_counters
+};
+
+// Searches with a latency histogram
+enum StatSearch {
+    STAT_SEARCH_ROLLOUT,        // compute_scores, compute_adaptive_scores, compute_timed_scores
+    STAT_SEARCH_EXPECTIMAX,     // compute_expectimax_scores
+    STAT_SEARCH_MCTS,           // MCTS::search and MCTS::search_for
+    n_stat_searches
+};
+
+// Latency histogram with 4 buckets per power of two nanoseconds, see latency_bucket
+const int n_latency_buckets = 160;
+
+// Bucket of a latency: below 4 ns the latency itself, above that 4 * (log2(ns) - 1) plus the two bits
+// after the leading one, so every bucket spans a quarter of its power of two
+inline int latency_bucket(uint64_t ns) {
+    if (ns < 4) return (int)ns;
+    const int octave = 63 - __builtin_clzll(ns);
+    const int bucket = 4 * (octave - 1) + (int)((ns >> (octave - 2)) & 3);
+    return bucket < n_latency_buckets ? bucket : n_latency_buckets - 1;
+}
+
+// Upper bound of a bucket in nanoseconds
+inline double latency_bucket_end(int bucket) {
+    if (bucket < 4) return bucket + 1;
+    return (double)((uint64_t)(5 + bucket % 4) << (bucket / 4 - 1));
+}
+
+struct ThreadStats {
+    std::array<std::atomic<uint64_t>, n_stat_counters> counters{};
+    std::array<std::array<std::atomic<uint64_t>, n_latency_buckets>, n_stat_searches> latency{};
+    std::array<std::atomic<uint64_t>, n_stat_searches> latency_ns{};
+    std::array<std::atomic<uint64_t>, n_stat_searches> max_latency_ns{};
+};
+
+// Counters of the calling thread, registered on first use and kept after the thread ends
+ThreadStats& thread_stats();
+
+// Only the owning thread writes its counters, so a relaxed load and store is enough
+inline void stat_add(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+inline void stat_add(StatCounter counter, uint64_t value) {
+    stat_add(thread_stats().counters[counter], value);
+}
+
+inline uint64_t stat_cycles() {
+#if MCTS2048_STATS && defined(__x86_64__)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void record_latency(StatSearch search, uint64_t ns);
+
+#if MCTS2048_STATS
+
+// Counts of one rollout. lap() charges the cycles since the previous lap to a counter, if the rollout is timed
+class RolloutStats {
+public:
+    RolloutStats() : stats(thread_stats()) {
+        timed = (stats.counters[STAT_ROLLOUTS].load(std::memory_order_relaxed) & 15) == 0;
+        last = timed ? stat_cycles() : 0;
+    }
+
+    ~RolloutStats() {
+        stat_add(stats.counters[STAT_ROLLOUTS], 1);
+        stat_add(stats.counters[STAT_ROLLOUT_STEPS], steps);
+        stat_add(stats.counters[STAT_ROLLOUT_GAME_OVERS], game_over ? 1 : 0);
+        if (!timed) return;
+        stat_add(stats.counters[STAT_TIMED_STEPS], steps);
+        for (int i = 0; i < 3; ++i) stat_add(stats.counters[STAT_MOVE_CYCLES + i], cycles[i]);
+    }
+
+    void lap(StatCounter counter) {
+        if (!timed) return;
+        const uint64_t now = stat_cycles();
+        cycles[counter - STAT_MOVE_CYCLES] += now - last;
+        last = now;
+    }
+
+    void step() {
+        steps++;
+    }
+
+    void end_of_game() {
+        game_over = true;
+    }
+
+private:
+    ThreadStats& stats;
+    bool timed;
+    uint64_t last;
+    uint64_t cycles[3] = {0, 0, 0};
+    uint64_t steps = 0;
+    bool game_over = false;
+};
+
+// Records the time from construction to destruction in the latency histogram of a search
+class SearchLatency {
+public:
+    explicit SearchLatency(StatSearch search) : search(search), start(std::chrono::steady_clock::now()) {
+    }
+
+    ~SearchLatency() {
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        record_latency(search, (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
+private:
+    StatSearch search;
+    std::chrono::steady_clock::time_point start;
+};
+
+#define STAT_ADD(counter, value) stat_add(counter, value)
+
+#else
+
+class RolloutStats {
+public:
+    void lap(StatCounter) {
+    }
+
+    void step() {
+    }
+
+    void end_of_game() {
+    }
+};
+
+class SearchLatency {
+public:
+    explicit SearchLatency(StatSearch) {
+    }
+};
+
+#define STAT_ADD(counter, value) ((void)0)
+
+#endif
+
+// Sum over all threads since the last reset_stats()
+struct SearchStats {
+    bool enabled;                  // built with MCTS2048_STATS
+    double cycles_per_ns;          // rate of the cycle counter, measured against the steady clock
+    std::array<uint64_t, n_stat_counters> counters;
+    std::array<std::array<uint64_t, n_latency_buckets>, n_stat_searches> latency;
+    std::array<uint64_t, n_stat_searches> latency_ns;
+    std::array<uint64_t, n_stat_searches> max_latency_ns;
+};
+
+SearchStats get_stats();
+
+// Zeroes all counters. counts of searches that run at the same time may get lost
+void reset_stats();
+
+const char* stat_counter_name(int counter);
+const char* stat_search_name(int search);
+
+// Latency below which a fraction q of the searches finished, from the histogram (upper bucket bound)
+double latency_quantile_ns(const SearchStats& stats, int search, double q);
+
+// The counters as a JSON object, with the derived rollout figures and per search the latency quantiles in
+// microseconds and the histogram buckets (see latency_bucket). the CLI tools print it, get_stats in python
+// returns it parsed
+std::string stats_json(const SearchStats& stats);
+
+#endif // STATS_H
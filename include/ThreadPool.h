@@ -0,0 +1,144 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstddef>
+#include <exception>
+
+// Fixed-size pool of worker threads. parallel_for hands out task indices to the workers
+// and blocks until every task has run.
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t n_threads) {
+        if (n_threads == 0) n_threads = 1;
+        for (size_t i = 0; i < n_threads; ++i) {
+            workers.emplace_back([this] { worker_loop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    // Runs fn(i) for every i in [0, n_tasks). Called from inside a worker (nested parallelism)
+    // the tasks run inline, otherwise the worker would wait on tasks queued behind itself.
+    // the first exception thrown by fn is rethrown here once every task has finished
+    void parallel_for(size_t n_tasks, const std::function<void(size_t)>& fn) {
+        if (n_tasks == 0) return;
+        if (in_worker() || n_tasks == 1) {
+            for (size_t i = 0; i < n_tasks; ++i) {
+                check_interrupt();
+                fn(i);
+            }
+            return;
+        }
+
+        //the completion state lives on this stack: remaining is only changed under done_mutex, so the wait
+        //below cannot return while the last task still holds the mutex or is about to notify
+        size_t remaining = n_tasks;
+        std::exception_ptr error;
+        std::mutex done_mutex;
+        std::condition_variable done_cv;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < n_tasks; ++i) {
+                tasks.push([&, i] {
+                    std::exception_ptr task_error;
+                    try {
+                        fn(i);
+                    } catch (...) {
+                        task_error = std::current_exception();
+                    }
+                    std::lock_guard<std::mutex> done_lock(done_mutex);
+                    if (task_error && !error) error = task_error;
+                    if (--remaining == 0) done_cv.notify_one();
+                });
+            }
+        }
+        cv.notify_all();
+
+        std::unique_lock<std::mutex> done_lock(done_mutex);
+        done_cv.wait(done_lock, [&] { return remaining == 0; });
+        if (error) std::rethrow_exception(error);
+    }
+
+    // Thrown by parallel_for calls that run inline once the interrupt flag of the thread is set
+    struct Interrupted : std::exception {
+        const char* what() const noexcept override {
+            return "interrupted";
+        }
+    };
+
+    // Makes the inline parallel_for calls of the calling thread check flag before every task and throw
+    // Interrupted once it is set, so that a long search can be stopped between its tasks. nullptr turns
+    // the checks off
+    static void set_interrupt_flag(const std::atomic<bool>* flag) {
+        interrupt_flag() = flag;
+    }
+
+    // Throws Interrupted once the interrupt flag of the calling thread is set, for tasks that are long on
+    // their own and check more often than parallel_for does
+    static void check_interrupt() {
+        const std::atomic<bool>* interrupt = interrupt_flag();
+        if (interrupt && interrupt->load(std::memory_order_relaxed)) throw Interrupted();
+    }
+
+    // Makes parallel_for calls from the calling thread run inline, like on a worker. for threads that run
+    // whole searches side by side, such as the workers of SearchService
+    static void mark_worker_thread() {
+        in_worker() = true;
+    }
+
+private:
+    static bool& in_worker() {
+        thread_local bool flag = false;
+        return flag;
+    }
+
+    static const std::atomic<bool>*& interrupt_flag() {
+        thread_local const std::atomic<bool>* flag = nullptr;
+        return flag;
+    }
+
+    void worker_loop() {
+        in_worker() = true;
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,135 @@
+#ifndef TRANSPOSITIONTABLE_H
+#define TRANSPOSITIONTABLE_H
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+// Fixed-size, open-addressed cache of search values keyed on (board, depth).
+// all memory is allocated up front, a lookup touches one bucket of two adjacent slots.
+// the table is lock-free: every slot stores key ^ data next to data, so a slot that is torn by a
+// concurrent write fails the key check and reads as a miss instead of returning a wrong value.
+class TranspositionTable {
+public:
+    explicit TranspositionTable(int log2_entries) {
+        resize(log2_entries);
+    }
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    // Not thread-safe, must not be called while a search is using the table
+    void resize(int log2_entries) {
+        if (log2_entries < 1) log2_entries = 1;
+        n_entries = size_t(1) << log2_entries;
+        slots.reset(new Slot[n_entries]);
+        clear();
+    }
+
+    void clear() {
+        for (size_t i = 0; i < n_entries; ++i) {
+            slots[i].key.store(0, std::memory_order_relaxed);
+            slots[i].data.store(0, std::memory_order_relaxed);
+        }
+        generation.store(1, std::memory_order_relaxed);
+    }
+
+    // Called once per search, entries of older searches are replaced first
+    void new_search() {
+        uint32_t g = generation.load(std::memory_order_relaxed) + 1;
+        if ((g & 0xFF) == 0) g++; //generation 0 marks empty slots
+        generation.store(g, std::memory_order_relaxed);
+    }
+
+    size_t size() const {
+        return n_entries;
+    }
+
+    // Finds a value that was searched at least as deep as depth
+    bool probe(uint64_t board, int depth, float& value) const {
+        const Slot* bucket = &slots[bucket_index(board)];
+        for (int i = 0; i < 2; ++i) {
+            const uint64_t data = bucket[i].data.load(std::memory_order_relaxed);
+            const uint64_t key = bucket[i].key.load(std::memory_order_relaxed);
+            if ((key ^ data) == board && data_generation(data) != 0 && data_depth(data) >= depth) {
+                value = data_value(data);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Replacement: same board if the new result is at least as deep, otherwise the slot of an older
+    // search, otherwise the shallower of the two slots
+    void store(uint64_t board, int depth, float value) {
+        Slot* bucket = &slots[bucket_index(board)];
+        const uint32_t g = generation.load(std::memory_order_relaxed) & 0xFF;
+        const uint64_t data = pack(value, depth, g);
+
+        int victim = -1;
+        for (int i = 0; i < 2; ++i) {
+            const uint64_t old_data = bucket[i].data.load(std::memory_order_relaxed);
+            const uint64_t old_key = bucket[i].key.load(std::memory_order_relaxed);
+            if ((old_key ^ old_data) == board && data_generation(old_data) != 0) {
+                if (data_depth(old_data) > depth) return;
+                victim = i;
+                break;
+            }
+        }
+        if (victim < 0) {
+            const uint64_t d0 = bucket[0].data.load(std::memory_order_relaxed);
+            const uint64_t d1 = bucket[1].data.load(std::memory_order_relaxed);
+            const bool stale0 = data_generation(d0) != g;
+            const bool stale1 = data_generation(d1) != g;
+            if (stale0 != stale1) victim = stale0 ? 0 : 1;
+            else victim = data_depth(d0) <= data_depth(d1) ? 0 : 1;
+        }
+        bucket[victim].key.store(board ^ data, std::memory_order_relaxed);
+        bucket[victim].data.store(data, std::memory_order_relaxed);
+    }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> key{0};
+        std::atomic<uint64_t> data{0};
+    };
+
+    // data layout: value as float bits in 0-31, depth in 32-39, generation in 40-47
+    static uint64_t pack(float value, int depth, uint32_t g) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return (uint64_t)bits | ((uint64_t)(depth & 0xFF) << 32) | ((uint64_t)(g & 0xFF) << 40);
+    }
+
+    static float data_value(uint64_t data) {
+        const uint32_t bits = (uint32_t)data;
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    static int data_depth(uint64_t data) {
+        return (int)((data >> 32) & 0xFF);
+    }
+
+    static uint32_t data_generation(uint64_t data) {
+        return (uint32_t)((data >> 40) & 0xFF);
+    }
+
+    size_t bucket_index(uint64_t board) const {
+        //splitmix64 finalizer, boards differ only in a few nibbles
+        uint64_t z = board;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+        return (size_t)z & (n_entries - 2);
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    size_t n_entries = 0;
+    std::atomic<uint32_t> generation{1};
+};
+
+#endif // TRANSPOSITIONTABLE_H
@@ -12,22 +12,33 @@
 #include <cstdint>
 #include <utility>
 
-#include <pybind11/pybind11.h>
-#include <pybind11/numpy.h>
-#include <pybind11/stl.h>
-
-namespace py = pybind11;
+#include "heuristics.h"
 
 using namespace std;
 
+// No-op, the lookup tables are filled when the library is loaded
 void initialize_tables();
 
+class ThreadPool;
+
+ThreadPool& get_rollout_pool();
+
+void set_num_threads(int n_threads);
+
+int get_num_threads();
+
 bool can_move(uint64_t board, int direction);
 
 tuple<uint64_t, uint> move(uint64_t board, int direction);
 
 tuple<uint64_t, uint> cached_move(uint64_t board, int direction);
 
+void move_batch(const uint64_t* boards, const int32_t* directions, uint64_t* out_boards, uint32_t* out_scores, size_t n);
+
+void move_batch(const uint64_t* boards, int direction, uint64_t* out_boards, uint32_t* out_scores, size_t n);
+
+const char* move_batch_kernel_name();
+
 uint64_t add_new_tile(uint64_t board);
 
 bool is_game_over(uint64_t board);
@@ -38,12 +49,103 @@ vector<uint> get_possible_moves(uint64_t board);
 
 uint compute_best_move(const uint64_t board, const int samples, const int depth, const int policy);
 
+double rollout(const uint64_t base_board, const uint base_score, const int depth, const int policy);
+
 vector<double> compute_scores(const uint64_t board, const int samples, const int depth, const int policy, vector<uint> moves);
 
 vector<double> py_compute_scores(const uint64_t board, const int samples, const int depth, const int policy);
 
+// Result of the adaptive search: the mean rollout return of every move, the number of rollouts it got
+// and the half width of its confidence interval (z standard errors). 0 for moves that are not possible
+// and for the moves of a board with a single possible move, which needs no rollouts
+struct AdaptiveScores {
+    uint best_move;
+    int rollouts;
+    std::array<double, 4> means;
+    std::array<double, 4> half_widths;
+    std::array<int, 4> counts;
+};
+
+// Like compute_scores, but the rollouts go to the moves that are still in question: stops once the
+// confidence interval of the best move is above the intervals of all others, or every move has samples
+AdaptiveScores compute_adaptive_scores(const uint64_t board, const int samples, const int depth, const int policy, const double z);
+
+uint compute_adaptive_best_move(const uint64_t board, const int samples, const int depth, const int policy, const double z);
+
+// Result of the deadline-bounded rollout search: the mean rollout return and the number of rollouts of
+// every move, 0 for moves that are not possible, and the time the search took
+struct TimedScores {
+    uint best_move;
+    uint64_t rollouts;
+    double elapsed_us;
+    std::array<double, 4> means;
+    std::array<int, 4> counts;
+};
+
+// Anytime rollout search: plays rollouts on all workers until budget_us microseconds have passed and
+// returns the best move by mean return. a board with a single possible move returns right away
+TimedScores compute_timed_scores(const uint64_t board, const int64_t budget_us, const int depth, const int policy);
+
+uint compute_timed_best_move(const uint64_t board, const int64_t budget_us, const int depth, const int policy);
+
+// Result of the paired rollout search: per move the mean rollout return and its standard error, per pair
+// of moves the mean paired difference differences[a][b] (= means[a] - means[b]) and its standard error.
+// both rollouts of a sample share their random numbers and spawn on the same cell wherever their boards
+// allow it (spawn_tile_common), but the boards after different moves differ in most cells: measured on
+// game positions, the paired error was 0.93-0.99 of the error of the difference of two independent means.
+// where the rollouts of two moves share a large random outcome, like a merge the policy may or may not
+// make, it falls to 0.4-0.7. 0 for moves that are not possible and for the moves of a board with a single
+// possible move
+struct PairedScores {
+    uint best_move;
+    int samples;
+    std::array<double, 4> means;
+    std::array<double, 4> std_errors;
+    std::array<std::array<double, 4>, 4> differences;
+    std::array<std::array<double, 4>, 4> difference_errors;
+};
+
+// Like compute_scores with common random numbers: sample j of every move plays its rollout from the same
+// counter based random stream, which takes the noise the rollouts of two moves share out of the
+// comparison between them (see PairedScores)
+PairedScores compute_paired_scores(const uint64_t board, const int samples, const int depth, const int policy);
+
+uint compute_paired_best_move(const uint64_t board, const int samples, const int depth, const int policy);
+
 vector<vector<uint>> board_to_array(const uint64_t board);
 
 uint compute_simple_best_move(uint64_t board, int policy);
 
+struct Successors;
+
+uint choose_move(const Successors& next, int policy);
+
+vector<double> compute_expectimax_scores(const uint64_t board, const int depth, const double min_probability);
+
+uint compute_expectimax_move(const uint64_t board, const int depth, const double min_probability);
+
+void set_expectimax_table_size(int log2_entries);
+
+void clear_expectimax_table();
+
+uint64_t new_game_board();
+
+void reset_boards(uint64_t* boards, size_t n);
+
+void step_boards(uint64_t* boards, const int32_t* actions, uint32_t* rewards, uint8_t* dones, size_t n, bool auto_reset);
+
+void game_over_mask(const uint64_t* boards, uint8_t* dones, size_t n);
+
+// Canonical form of every board and the index of the symmetry that maps the board to it (see canonical_board)
+void canonicalize_boards(const uint64_t* boards, uint64_t* out_boards, uint8_t* symmetries, size_t n);
+
+// The symmetries[i]-th symmetry of every board, in the order of board_symmetries
+void transform_boards(const uint64_t* boards, const uint8_t* symmetries, uint64_t* out_boards, size_t n);
+
+void simple_best_moves(const uint64_t* boards, int32_t* actions, size_t n, int policy);
+
+const int n_features = 56;
+
+void extract_features(const uint64_t* boards, float* features, size_t n);
+
 #endif // GAME_H
\ No newline at end of file
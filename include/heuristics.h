@@ -0,0 +1,93 @@
+#ifndef HEURISTICS_H
+#define HEURISTICS_H
+
+#include "tables.h"
+#include <cstdint>
+
+// Heuristic row tables. every feature is computed once per possible row (4 nibbles) when the library
+// is loaded, a board feature is then the sum over its 4 rows and the 4 rows of the
+// transposed board. columns use the same tables as rows, since a column read top to bottom
+// is a row of the transposed board. the lookups are inline, so that the policies can be inlined
+// into the rollout loops
+extern uint8_t heur_empty[65536];           // number of empty cells
+extern uint8_t heur_merges[65536];          // number of tiles that can merge with a neighbour
+extern float heur_monotonicity[65536];      // penalty for the row going up and down, lower is more monotonic
+extern float heur_smoothness[65536];        // summed rank difference of neighbouring tiles, lower is smoother
+extern float heur_score[65536];             // weighted sum of the features above, what evaluate_board adds up
+extern uint16_t heur_min_diff[65536];       // per cell the smaller rank difference to its left/right neighbour
+
+// Features of a row of n cells from the ranks of its tiles (0 for an empty cell), what the tables above
+// hold for the rows of 4. the lost penalty in score is split over n rows, so that the rows and columns of
+// a square board of n rows add it up like evaluate_board does
+struct RowFeatures {
+    int empty;
+    int merges;
+    double monotonicity;
+    double smoothness;
+    double score;
+};
+
+RowFeatures row_features(const int* rank, int n);
+
+template <typename T>
+inline double sum_rows(const T* table, uint64_t board) {
+    return (double)table[(board >> 0) & 0xFFFF] + (double)table[(board >> 16) & 0xFFFF] +
+           (double)table[(board >> 32) & 0xFFFF] + (double)table[(board >> 48) & 0xFFFF];
+}
+
+inline double evaluate_board(uint64_t board) {
+    //8 lookups: the 4 rows and the 4 columns. the lost penalty is split over the rows,
+    //so it adds up to heur_lost_penalty once for the rows and once for the columns
+    return sum_rows(heur_score, board) + sum_rows(heur_score, transpose(board));
+}
+
+inline double board_monotonicity(uint64_t board) {
+    return sum_rows(heur_monotonicity, board) + sum_rows(heur_monotonicity, transpose(board));
+}
+
+inline double board_smoothness(uint64_t board) {
+    return sum_rows(heur_smoothness, board) + sum_rows(heur_smoothness, transpose(board));
+}
+
+inline unsigned count_merges(uint64_t board) {
+    return (unsigned)(sum_rows(heur_merges, board) + sum_rows(heur_merges, transpose(board)));
+}
+
+inline unsigned count_zeros(uint64_t board) {
+    return heur_empty[(board >> 0) & 0xFFFF] + heur_empty[(board >> 16) & 0xFFFF] +
+           heur_empty[(board >> 32) & 0xFFFF] + heur_empty[(board >> 48) & 0xFFFF];
+}
+
+inline uint64_t min_diff_rows(uint64_t board) {
+    return ((uint64_t)heur_min_diff[(board >> 0) & 0xFFFF] << 0) |
+           ((uint64_t)heur_min_diff[(board >> 16) & 0xFFFF] << 16) |
+           ((uint64_t)heur_min_diff[(board >> 32) & 0xFFFF] << 32) |
+           ((uint64_t)heur_min_diff[(board >> 48) & 0xFFFF] << 48);
+}
+
+// Per-byte min of two words whose bytes are all below 128
+inline uint64_t min_bytes(uint64_t a, uint64_t b) {
+    const uint64_t high = 0x8080808080808080ULL;
+    const uint64_t a_ge_b = (((a | high) - b) & high) >> 7; //1 in every byte where a >= b
+    const uint64_t select_b = a_ge_b * 0xFF;
+    return (a & ~select_b) | (b & select_b);
+}
+
+inline unsigned sum_bytes(uint64_t x) {
+    return (unsigned)((x * 0x0101010101010101ULL) >> 56);
+}
+
+inline unsigned count_min_adjacent_diff(uint64_t board) {
+    //every cell has a horizontal and a vertical neighbour, so both per-cell minima fit in a nibble.
+    //the horizontal ones come from the row table, the vertical ones from the row table on the
+    //transposed board. the two are combined per nibble, split into even and odd nibbles so that
+    //every value gets a byte of headroom
+    const uint64_t horizontal = min_diff_rows(board);
+    const uint64_t vertical = transpose(min_diff_rows(transpose(board)));
+    const uint64_t nibbles = 0x0F0F0F0F0F0F0F0FULL;
+    const uint64_t even = min_bytes(horizontal & nibbles, vertical & nibbles);
+    const uint64_t odd = min_bytes((horizontal >> 4) & nibbles, (vertical >> 4) & nibbles);
+    return sum_bytes(even) + sum_bytes(odd);
+}
+
+#endif // HEURISTICS_H
@@ -0,0 +1,326 @@
+#ifndef POLICIES_H
+#define POLICIES_H
+
+#include "tables.h"
+#include "heuristics.h"
+#include "Random.h"
+#include "Network.h"
+#include "NTupleNetwork.h"
+#include "Stats.h"
+#include <array>
+#include <tuple>
+#include <utility>
+#include <cstddef>
+#include <cstdint>
+
+// Rollout policies. every policy is a struct with a static choose(), which picks a move from the
+// successors of a board with any generator of Random.h. choose() is only called with at least two legal moves. the policy number used
+// by compute_simple_best_move, compute_scores etc. is the position in PolicyList. the hot loops are
+// templates on the policy, instantiated once per policy through make_policy_table, so the policy is
+// inlined into the loop and picked once per call instead of once per step.
+// adding a policy: write the struct and append it to PolicyList
+
+// Index of the first legal move
+inline unsigned first_move(unsigned legal) {
+    return (unsigned)__builtin_ctz(legal);
+}
+
+// A uniformly random legal move
+template <typename Generator>
+inline unsigned random_move(unsigned legal, Generator& rng) {
+    const uint32_t k = rng.bounded(__builtin_popcount(legal));
+    return first_move((unsigned)select_bit(legal, k));
+}
+
+// Policy 0, avg score: 4100. fewest differences between neighbouring tiles
+struct MinAdjacentDiffPolicy {
+    template <typename Generator>
+    static unsigned choose(const Successors& next, Generator&) {
+        unsigned lowest_score = 0;
+        unsigned best_direction = 4;
+        for (unsigned direction = 0; direction < 4; ++direction) {
+            if (!(next.legal & (1u << direction))) continue;
+            const unsigned score = count_min_adjacent_diff(next.boards[direction]);
+            if (best_direction == 4 || score < lowest_score) {
+                lowest_score = score;
+                best_direction = direction;
+            }
+        }
+        return best_direction;
+    }
+};
+
+// Policy 1, avg score: 2980. most empty cells
+struct MostEmptyPolicy {
+    template <typename Generator>
+    static unsigned choose(const Successors& next, Generator&) {
+        unsigned highest_score = 0;
+        unsigned best_direction = 4;
+        for (unsigned direction = 0; direction < 4; ++direction) {
+            if (!(next.legal & (1u << direction))) continue;
+            const unsigned score = count_zeros(next.boards[direction]);
+            if (best_direction == 4 || score > highest_score) {
+                highest_score = score;
+                best_direction = direction;
+            }
+        }
+        return best_direction;
+    }
+};
+
+// Policy 2, avg score: 830. just use the first possible direction, also the fallback for unknown policies
+struct FirstMovePolicy {
+    template <typename Generator>
+    static unsigned choose(const Successors& next, Generator&) {
+        return first_move(next.legal);
+    }
+};
+
+// Policy 3. randomly choose a direction
+struct RandomPolicy {
+    template <typename Generator>
+    static unsigned choose(const Successors& next, Generator& rng) {
+        return random_move(next.legal, rng);
+    }
+};
+
+// Policy 4. policy 0, but the scores are used as probabilities
+struct SampledMinAdjacentDiffPolicy {
+    template <typename Generator>
+    static unsigned choose(const Successors& next, Generator& rng) {
+        const unsigned legal = next.legal;
+        double scores[4] = {0, 0, 0, 0};
+        double max_score = 0;
+        for (unsigned direction = 0; direction < 4; ++direction) {
+            if (!(legal & (1u << direction))) continue;
+            scores[direction] = count_min_adjacent_diff(next.boards[direction]);
+            if (scores[direction] > max_score) max_score = scores[direction];
+        }
+        //subtract the scores from the maximum score - the higher the score, the lower the value
+        double sum = 0;
+        for (unsigned direction = 0; direction < 4; ++direction) {
+            if (!(legal & (1u << direction))) continue;
+            scores[direction] = max_score - scores[direction];
+            sum += scores[direction];
+        }
+        if (sum <= 0) return first_move(legal); //all moves equally good
+        //now we have a probability distribution, we can sample from it
+        double r = rng.uniform() * sum;
+        for (unsigned direction = 0; direction < 4; ++direction) {
+            if (!(legal & (1u << direction))) continue;
+            r -= scores[direction];
+            if (r < 0) return direction;
+        }
+        return first_move(legal); //only reached through rounding
+    }
+};
+
+// Policy 5. greedy on the table based board evaluator
+struct GreedyEvaluationPolicy {
+    template <typename Generator>
+    static unsigned choose(const Successors& next, Generator&) {
+        double highest_score = 0;
+        unsigned best_direction = 4;
+        for (unsigned direction = 0; direction < 4; ++direction) {
+            if (!(next.legal & (1u << direction))) continue;
+            const double score = evaluate_board(next.boards[direction]);
+            if (best_direction == 4 || score > highest_score) {
+                highest_score = score;
+                best_direction = direction;
+            }
+        }
+        return best_direction;
+    }
+};
+
+// Policy 6. policy 5, but the evaluations are used as probabilities
+struct SampledEvaluationPolicy {
+    template <typename Generator>
+    static unsigned choose(const Successors& next, Generator& rng) {
+        const unsigned legal = next.legal;
+        double scores[4] = {0, 0, 0, 0};
+        double min_score = 0;
+        bool first = true;
+        for (unsigned direction = 0; direction < 4; ++direction) {
+            if (!(legal & (1u << direction))) continue;
+            scores[direction] = evaluate_board(next.boards[direction]);
+            if (first || scores[direction] < min_score) min_score = scores[direction];
+            first = false;
+        }
+        //shift so that the worst move gets probability 0
+        double sum = 0;
+        for (unsigned direction = 0; direction < 4; ++direction) {
+            if (!(legal & (1u << direction))) continue;
+            scores[direction] -= min_score;
+            sum += scores[direction];
+        }
+        if (sum <= 0) return random_move(legal, rng);
+        double r = rng.uniform() * sum;
+        for (unsigned direction = 0; direction < 4; ++direction) {
+            if (!(legal & (1u << direction))) continue;
+            r -= scores[direction];
+            if (r < 0) return direction;
+        }
+        return first_move(legal);
+    }
+};
+
+// Policy 7. the legal move with the highest output of the policy network (load_policy_network), which
+// was trained on the move scores of the board before the move. first move while no network is loaded
+struct NetworkPolicy {
+    template <typename Generator>
+    static unsigned choose(const Successors& next, Generator&) {
+        const Network* network = policy_network();
+        if (!network) return first_move(next.legal);
+        float features[56];
+        float outputs[4];
+        board_features(next.board, features);
+        network->forward(features, outputs, 1);
+        return best_network_move(outputs, next.legal);
+    }
+
+    // The legal move with the highest output
+    static unsigned best_network_move(const float* outputs, unsigned legal) {
+        unsigned best_direction = 4;
+        for (unsigned direction = 0; direction < 4; ++direction) {
+            if (!(legal & (1u << direction))) continue;
+            if (best_direction == 4 || outputs[direction] > outputs[best_direction]) best_direction = direction;
+        }
+        return best_direction;
+    }
+};
+
+// Policy 8. greedy on merge score + afterstate value of the n-tuple network (set_ntuple_network), first
+// move while no network is set
+struct NTuplePolicy {
+    template <typename Generator>
+    static unsigned choose(const Successors& next, Generator&) {
+        const NTupleNetwork* network = ntuple_network();
+        return network ? network->best_move(next) : first_move(next.legal);
+    }
+};
+
+using PolicyList = std::tuple<
+    MinAdjacentDiffPolicy,
+    MostEmptyPolicy,
+    FirstMovePolicy,
+    RandomPolicy,
+    SampledMinAdjacentDiffPolicy,
+    GreedyEvaluationPolicy,
+    SampledEvaluationPolicy,
+    NetworkPolicy,
+    NTuplePolicy>;
+
+constexpr int n_policies = (int)std::tuple_size<PolicyList>::value;
+constexpr int default_policy = 2;
+
+// Picks a move, with the single legal move shortcut every policy shares. expects at least one legal move
+template <typename Policy, typename Generator>
+inline unsigned choose_with(const Successors& next, Generator& rng) {
+    if ((next.legal & (next.legal - 1)) == 0) return first_move(next.legal);
+    return Policy::choose(next, rng);
+}
+
+// Plays up to depth moves from board and returns the merge score collected on the way
+template <typename Policy>
+inline double play_out(uint64_t board, int depth, Rng& rng) {
+    RolloutStats stats; //empty unless built with MCTS2048_STATS
+    double score = 0;
+    for (int k = 0; k < depth; ++k) {
+        const Successors next = successors(board);
+        stats.lap(STAT_MOVE_CYCLES);
+        if (next.legal == 0) { //game over
+            stats.end_of_game();
+            break;
+        }
+        const unsigned direction = choose_with<Policy>(next, rng);
+        stats.lap(STAT_POLICY_CYCLES);
+        score += next.scores[direction];
+        board = spawn_tile(next.boards[direction], rng);
+        stats.lap(STAT_SPAWN_CYCLES);
+        stats.step();
+    }
+    return score;
+}
+
+// Draws of the paired rollouts. step s of a rollout (step 0 is the spawn that completes the move under
+// evaluation) owns the draws from common_draws_per_step * s on: the first orders the cells, the next 16
+// are the 2/4 draws of cells 0 to 15 and the policy draws from the one after them, so a draw of a
+// sample's stream is used for the same thing on the rollout of every move, however many draws a policy
+// took before
+const uint64_t common_draws_per_step = 32;
+const uint64_t common_policy_draw = 17;
+
+// spawn_tile with common random numbers, for boards that differ in some cells: the draw at first_draw
+// orders the 16 cells at random and the tile goes to the first empty cell in that order, a 2 (90%) or a
+// 4 (10%) by the draw at first_draw + 1 + cell. two boards get the same spawn unless a cell before it in
+// the order is empty on one board only. the k-th empty cell of spawn_tile moves as soon as the boards
+// differ in any empty cell before it: on the successors of game positions, two moves got the same spawn
+// in 27% of the samples against 12% with spawn_tile
+inline uint64_t spawn_tile_common(uint64_t board, uint64_t first_draw, CounterRng& rng) {
+    const uint64_t empty = empty_cells(board);
+    if (empty == 0) return board;
+
+    //Fisher-Yates, stopped at the first empty cell. every digit takes the high part of x * n, the rest
+    //of the draw stays in the low part, the 16! orders need 45 of its 64 bits
+    rng.seek(first_draw);
+    uint64_t x = rng.next64();
+    uint64_t order = 0xFEDCBA9876543210ULL; // cell of position i in nibble i
+    unsigned cell = 0;
+    for (unsigned i = 0; i < 16; ++i) {
+        const unsigned __int128 product = (unsigned __int128)x * (16 - i);
+        const unsigned j = i + (unsigned)(product >> 64);
+        x = (uint64_t)product;
+        cell = (order >> (4 * j)) & 0xF;
+        if (empty & (1ULL << (4 * cell))) break;
+        //position j takes the cell of position i, position i is not read again
+        order = (order & ~(0xFULL << (4 * j))) | (((order >> (4 * i)) & 0xF) << (4 * j));
+    }
+    rng.seek(first_draw + 1 + cell);
+    const uint64_t new_tile = (rng.next32() < 429496730u) ? 2 : 1;
+    return board | (new_tile << (4 * cell));
+}
+
+// play_out with common random numbers: the draws come from a counter based stream at fixed positions
+template <typename Policy>
+inline double play_out_common(uint64_t board, int depth, CounterRng& rng) {
+    RolloutStats stats; //empty unless built with MCTS2048_STATS
+    double score = 0;
+    for (int k = 0; k < depth; ++k) {
+        const Successors next = successors(board);
+        stats.lap(STAT_MOVE_CYCLES);
+        if (next.legal == 0) { //game over
+            stats.end_of_game();
+            break;
+        }
+        const uint64_t step = (uint64_t)(k + 1) * common_draws_per_step;
+        rng.seek(step + common_policy_draw);
+        const unsigned direction = choose_with<Policy>(next, rng);
+        stats.lap(STAT_POLICY_CYCLES);
+        score += next.scores[direction];
+        board = spawn_tile_common(next.boards[direction], step, rng);
+        stats.lap(STAT_SPAWN_CYCLES);
+        stats.step();
+    }
+    return score;
+}
+
+// Table with Fn::run<Policy> for every policy in PolicyList, indexed by the policy number
+template <typename Fn, size_t... I>
+constexpr auto make_policy_table(std::index_sequence<I...>) {
+    using Entry = decltype(&Fn::template run<std::tuple_element_t<0, PolicyList>>);
+    return std::array<Entry, sizeof...(I)>{{&Fn::template run<std::tuple_element_t<I, PolicyList>>...}};
+}
+
+template <typename Fn>
+constexpr auto make_policy_table() {
+    return make_policy_table<Fn>(std::make_index_sequence<n_policies>{});
+}
+
+// Entry of a policy table, unknown policy numbers fall back to default_policy
+template <typename Table>
+inline auto policy_entry(const Table& table, int policy) {
+    return table[(policy >= 0 && policy < n_policies) ? policy : default_policy];
+}
+
+#endif // POLICIES_H
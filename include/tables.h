@@ -0,0 +1,171 @@
+#ifndef TABLES_H
+#define TABLES_H
+
+#include "Random.h"
+#include <cstdint>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+// Row lookup tables, filled when the library is loaded. a row is 4 nibbles, the first cell in the lowest
+// nibble. an entry packs the row after the move in the low 16 bits and the merge score / 4 in the high
+// 16 bits (merge scores are multiples of 4 and at most 2 * 32768), so a row move is a single lookup and
+// both tables together are 512 KB. up and down use the same tables on the transposed board. two 32768
+// tiles do not merge, exponent 16 does not fit in a nibble (see Geometry.h for 5 bit cells)
+extern uint32_t move_table_left[65536];
+extern uint32_t move_table_right[65536];
+
+inline uint16_t move_table_result(uint32_t entry) {
+    return (uint16_t)entry;
+}
+
+inline unsigned move_table_score(uint32_t entry) {
+    return (entry >> 16) << 2;
+}
+
+// Swaps rows and columns of the board, so that column moves can use the row tables
+inline uint64_t transpose(uint64_t board) {
+    uint64_t a1 = board & 0xF0F00F0FF0F00F0FULL;
+    uint64_t a2 = board & 0x0000F0F00000F0F0ULL;
+    uint64_t a3 = board & 0x0F0F00000F0F0000ULL;
+    uint64_t a = a1 | (a2 << 12) | (a3 >> 12);
+    uint64_t b1 = a & 0xFF00FF0000FF00FFULL;
+    uint64_t b2 = a & 0x00FF00FF00000000ULL;
+    uint64_t b3 = a & 0x00000000FF00FF00ULL;
+    return b1 | (b2 >> 24) | (b3 << 24);
+}
+
+// Reverses the order of the cells in every row (left-right mirror)
+inline uint64_t mirror_rows(uint64_t board) {
+    return ((board & 0xF000F000F000F000ULL) >> 12) | ((board & 0x0F000F000F000F00ULL) >> 4) |
+           ((board & 0x00F000F000F000F0ULL) << 4) | ((board & 0x000F000F000F000FULL) << 12);
+}
+
+// Reverses the order of the rows (top-bottom mirror)
+inline uint64_t mirror_columns(uint64_t board) {
+    return (board >> 48) | ((board >> 16) & 0x00000000FFFF0000ULL) |
+           ((board << 16) & 0x0000FFFF00000000ULL) | (board << 48);
+}
+
+// The 8 rotations and reflections of the board, the board itself first
+inline void board_symmetries(uint64_t board, uint64_t out[8]) {
+    const uint64_t t = transpose(board);
+    out[0] = board;
+    out[1] = mirror_rows(board);
+    out[2] = mirror_columns(board);
+    out[3] = mirror_rows(out[2]);
+    out[4] = t;
+    out[5] = mirror_rows(t);
+    out[6] = mirror_columns(t);
+    out[7] = mirror_rows(out[6]);
+}
+
+// The k-th board of board_symmetries
+inline uint64_t apply_symmetry(uint64_t board, unsigned k) {
+    if (k & 4) board = transpose(board);
+    if (k & 2) board = mirror_columns(board);
+    if (k & 1) board = mirror_rows(board);
+    return board;
+}
+
+// Move d on a board is move symmetry_moves[k][d] on its k-th symmetry, and move d on the k-th symmetry
+// is inverse_symmetry_moves[k][d] on the board
+constexpr uint8_t symmetry_moves[8][4] = {
+    {0, 1, 2, 3}, {1, 0, 2, 3}, {0, 1, 3, 2}, {1, 0, 3, 2},
+    {2, 3, 0, 1}, {2, 3, 1, 0}, {3, 2, 0, 1}, {3, 2, 1, 0},
+};
+
+constexpr uint8_t inverse_symmetry_moves[8][4] = {
+    {0, 1, 2, 3}, {1, 0, 2, 3}, {0, 1, 3, 2}, {1, 0, 3, 2},
+    {2, 3, 0, 1}, {3, 2, 0, 1}, {2, 3, 1, 0}, {3, 2, 1, 0},
+};
+
+// Canonical form of a board: the smallest of its 8 symmetries, and which one it is. symmetric boards
+// have the same canonical form, so caches and datasets keyed on it see every position once
+struct CanonicalBoard {
+    uint64_t board;
+    unsigned symmetry;
+};
+
+inline CanonicalBoard canonical_board(uint64_t board) {
+    uint64_t symmetries[8];
+    board_symmetries(board, symmetries);
+    CanonicalBoard canonical = {symmetries[0], 0};
+    for (unsigned k = 1; k < 8; ++k) {
+        if (symmetries[k] < canonical.board) canonical = {symmetries[k], k};
+    }
+    return canonical;
+}
+
+// One bit per empty cell, at the lowest bit of its nibble
+inline uint64_t empty_cells(uint64_t board) {
+    uint64_t x = board | (board >> 1);
+    x |= x >> 2;
+    return ~x & 0x1111111111111111ULL;
+}
+
+// The k-th lowest set bit of mask, k counting from 0
+inline uint64_t select_bit(uint64_t mask, uint32_t k) {
+#ifdef __BMI2__
+    return _pdep_u64(1ULL << k, mask);
+#else
+    for (uint32_t i = 0; i < k; ++i) mask &= mask - 1;
+    return mask & (~mask + 1);
+#endif
+}
+
+// Adds a 2 (90%) or a 4 (10%) on a random empty cell: the k-th set bit of the empty cell mask,
+// no allocation and a single 64 bit draw
+template <typename Generator>
+inline uint64_t spawn_tile(uint64_t board, Generator& rng) {
+    const uint64_t empty = empty_cells(board);
+    if (empty == 0) return board;
+
+    const uint64_t r = rng.next64();
+    const uint32_t k = (uint32_t)(((r & 0xFFFFFFFF) * (uint64_t)__builtin_popcountll(empty)) >> 32);
+    const uint64_t cell = select_bit(empty, k);
+    const uint64_t new_tile = ((r >> 32) < 429496730u) ? 2 : 1;
+
+    return board | (cell * new_tile);
+}
+
+// Applies a row table to all 4 rows of the board
+inline uint64_t move_rows(uint64_t board, const uint32_t* table, unsigned& out_score) {
+    const uint32_t e0 = table[(uint16_t)(board >> 0)];
+    const uint32_t e1 = table[(uint16_t)(board >> 16)];
+    const uint32_t e2 = table[(uint16_t)(board >> 32)];
+    const uint32_t e3 = table[(uint16_t)(board >> 48)];
+    out_score = ((e0 >> 16) + (e1 >> 16) + (e2 >> 16) + (e3 >> 16)) << 2;
+    return ((uint64_t)move_table_result(e0) << 0) |
+           ((uint64_t)move_table_result(e1) << 16) |
+           ((uint64_t)move_table_result(e2) << 32) |
+           ((uint64_t)move_table_result(e3) << 48);
+}
+
+// All four successors of a board: the board after every move, its merge score and a bitmask of the
+// moves that change the board (bit d for direction d). the rows and the columns are both read from
+// the row tables, the columns through a single transpose of the board
+struct Successors {
+    uint64_t board;        // the board the moves start from
+    uint64_t boards[4];
+    unsigned scores[4];
+    unsigned legal;
+};
+
+inline Successors successors(uint64_t board) {
+    Successors s;
+    s.board = board;
+    const uint64_t t = transpose(board);
+    s.boards[0] = move_rows(board, move_table_left, s.scores[0]);
+    s.boards[1] = move_rows(board, move_table_right, s.scores[1]);
+    s.boards[2] = transpose(move_rows(t, move_table_left, s.scores[2]));
+    s.boards[3] = transpose(move_rows(t, move_table_right, s.scores[3]));
+    s.legal = (unsigned)(s.boards[0] != board) |
+              ((unsigned)(s.boards[1] != board) << 1) |
+              ((unsigned)(s.boards[2] != board) << 2) |
+              ((unsigned)(s.boards[3] != board) << 3);
+    return s;
+}
+
+#endif // TABLES_H
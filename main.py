@@ -1,6 +1,4 @@
-from mcts2048 import initialize_tables, move, add_new_tile, is_game_over, print_board, compute_best_move, compute_simple_best_move
-
-initialize_tables()
+from mcts2048 import move, add_new_tile, is_game_over, print_board, compute_best_move, compute_simple_best_move
 
 def show_game_with_best_move():
     board = 0
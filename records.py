@@ -0,0 +1,149 @@
+"""Self-play record files written by DatasetGenerator.
+
+The layout is documented in include/RecordFile.h: a 64 byte header followed by fixed-size 32 byte
+records. The records are mapped with np.memmap, so opening a file is instant and only the records
+that are used are read from disk.
+
+A 2048 position has 8 symmetric equivalents (rotations and reflections) with the same move scores, up to
+a permutation of the moves. canonicalize/deduplicate store every position once, in its canonical
+orientation, and transform/random_symmetries augment a batch with symmetric copies.
+
+A ReplayBuffer (include/ReplayBuffer.h) holds the same records in shared memory while self-play is still
+running: sample_replay draws minibatches from it straight into a record array.
+"""
+import numpy as np
+from mcts2048 import canonicalize_boards, transform_boards, symmetry_moves
+
+MAGIC = b"M2048REC"
+VERSION = 1
+
+header_dtype = np.dtype([
+    ("magic", "S8"),
+    ("version", "<u4"),
+    ("header_size", "<u4"),
+    ("record_size", "<u4"),
+    ("samples", "<i4"),
+    ("depth", "<i4"),
+    ("policy", "<i4"),
+    ("reserved", "u1", (32,)),
+])
+
+record_dtype = np.dtype([
+    ("board", "<u8"),
+    ("scores", "<f4", (4,)),
+    ("move", "u1"),
+    ("padding", "u1", (3,)),
+    ("reward", "<u4"),
+])
+
+assert header_dtype.itemsize == 64 and record_dtype.itemsize == 32
+
+
+def read_header(path):
+    """Header of a record file as a dict, raises ValueError for files of another format"""
+    header = np.fromfile(path, dtype=header_dtype, count=1)
+    if len(header) != 1 or header["magic"][0] != MAGIC:
+        raise ValueError(f"{path} is not a record file")
+    header = {name: header[name][0] for name in ("version", "header_size", "record_size", "samples", "depth", "policy")}
+    if header["version"] != VERSION or header["record_size"] != record_dtype.itemsize:
+        raise ValueError(f"{path} has record file version {header['version']}, expected {VERSION}")
+    return header
+
+
+def open_records(path):
+    """All complete records of a file as a read-only structured np.memmap (fields board, scores, move, reward)"""
+    header = read_header(path)
+    offset = int(header["header_size"])
+    with open(path, "rb") as f:
+        f.seek(0, 2)
+        count = (f.tell() - offset) // record_dtype.itemsize
+    if count == 0:
+        return np.zeros(0, dtype=record_dtype)
+    return np.memmap(path, dtype=record_dtype, mode="r", offset=offset, shape=(count,))
+
+
+def shard(records, index, count):
+    """Contiguous shard index of count shards, the shards differ in size by at most one record"""
+    if not 0 <= index < count:
+        raise ValueError("shard index out of range")
+    base, extra = divmod(len(records), count)
+    begin = index * base + min(index, extra)
+    return records[begin:begin + base + (1 if index < extra else 0)]
+
+
+def write_records(path, records, samples=-1, depth=-1, policy=-1):
+    """Writes records as a new record file, samples/depth/policy are the settings of the generator, -1 if unknown"""
+    header = np.zeros(1, dtype=header_dtype)
+    header["magic"] = MAGIC
+    header["version"] = VERSION
+    header["header_size"] = header_dtype.itemsize
+    header["record_size"] = record_dtype.itemsize
+    header[["samples", "depth", "policy"]] = (samples, depth, policy)
+    with open(path, "wb") as f:
+        header.tofile(f)
+        np.asarray(records, dtype=record_dtype).tofile(f)
+
+
+def convert_npz(npz_path, path):
+    """Writes the boards and scores of a training_data.npz from the old create_dataset.py as a record file.
+    the move is the best scored move, the reward is not stored in the npz and left at 0"""
+    data = np.load(npz_path)
+    records = np.zeros(len(data["boards"]), dtype=record_dtype)
+    records["board"] = data["boards"]
+    records["scores"] = data["scores"]
+    records["move"] = np.argmax(data["scores"], axis=1)
+    write_records(path, records)
+
+
+# SYMMETRY_MOVES[k, d]: move d on a board is move SYMMETRY_MOVES[k, d] on its k-th symmetry
+SYMMETRY_MOVES = symmetry_moves()
+
+
+def transform(boards, scores, symmetries, moves=None):
+    """The symmetries[i]-th symmetry of every board with its scores (and moves) permuted to match"""
+    symmetries = np.asarray(symmetries, dtype=np.uint8)
+    scores = np.asarray(scores)
+    permutation = SYMMETRY_MOVES[symmetries]
+    rows = np.arange(len(symmetries))[:, None]
+    new_scores = np.empty_like(scores)
+    new_scores[rows, permutation] = scores
+    new_boards = transform_boards(boards, symmetries)
+    if moves is None:
+        return new_boards, new_scores
+    return new_boards, new_scores, permutation[rows[:, 0], np.asarray(moves)]
+
+
+def random_symmetries(boards, scores, rng=np.random):
+    """Every board and its scores in a random one of its 8 orientations, for augmentation"""
+    return transform(boards, scores, rng.randint(0, 8, len(boards)))
+
+
+def canonicalize(records):
+    """Copy of the records with every board in its canonical orientation, scores and move permuted to match"""
+    _, symmetries = canonicalize_boards(records["board"])
+    out = np.array(records, dtype=record_dtype)
+    out["board"], out["scores"], out["move"] = transform(records["board"], records["scores"], symmetries, records["move"])
+    return out
+
+
+def deduplicate(records):
+    """The canonical records with every position once: the first record of boards that are equal up to symmetry"""
+    canonical = canonicalize(records)
+    _, first = np.unique(canonical["board"], return_index=True)
+    return canonical[np.sort(first)]
+
+
+def deduplicate_file(path, output):
+    """Writes the deduplicated records of a record file to output, returns the number of records kept"""
+    header = read_header(path)
+    records = deduplicate(open_records(path))
+    write_records(output, records, header["samples"], header["depth"], header["policy"])
+    return len(records)
+
+
+def sample_replay(buffer, n, out=None):
+    """n random records of a ReplayBuffer, written into out (reused between batches) if it is given.
+    None while the buffer is empty"""
+    if out is None:
+        out = np.empty(n, dtype=record_dtype)
+    return out[:n] if buffer.sample(out[:n]) else None
@@ -0,0 +1,57 @@
+import asyncio
+import sys
+import time
+from mcts2048 import SearchService, new_game_board, move, add_new_tile, is_game_over
+
+async def search_async(service, board, **config):
+    # the job finishes on a worker thread, the callback hands the result over to the event loop
+    loop = asyncio.get_running_loop()
+    future = loop.create_future()
+
+    def deliver(job):
+        if job.status() == "cancelled":
+            loop.call_soon_threadsafe(future.cancel)
+            return
+        try:
+            result = job.result()
+        except Exception as error:
+            loop.call_soon_threadsafe(future.set_exception, error)
+            return
+        loop.call_soon_threadsafe(future.set_result, result)
+
+    job = service.submit(board, **config)
+    job.add_done_callback(deliver)
+    try:
+        return await future
+    except asyncio.CancelledError:
+        job.cancel()
+        raise
+
+async def play_game(service, **config):
+    # one client: a whole game, every move a request to the service
+    board = new_game_board()
+    score = 0
+    moves = 0
+    while not is_game_over(board):
+        result = await search_async(service, board, **config)
+        board, gain = move(board, result["move"])
+        board = add_new_tile(board)
+        score += gain
+        moves += 1
+    return score, moves
+
+async def serve(n_games, **config):
+    # stand-in for a server loop: every game is a client, their requests are multiplexed onto the service
+    with SearchService() as service:
+        start = time.perf_counter()
+        results = await asyncio.gather(*(play_game(service, **config) for _ in range(n_games)))
+        elapsed = time.perf_counter() - start
+    total_moves = sum(moves for _, moves in results)
+    print(f"{n_games} games, {total_moves} searches in {elapsed:.1f} s ({total_moves / elapsed:.0f} searches/s) on {service.size()} threads")
+    print(f"mean score {sum(score for score, _ in results) / n_games:.0f}, max {max(score for score, _ in results)}")
+
+# Example usage: python serve_searches.py [games] [samples]
+if __name__ == "__main__":
+    n_games = int(sys.argv[1]) if len(sys.argv) > 1 else 32
+    samples = int(sys.argv[2]) if len(sys.argv) > 2 else 200
+    asyncio.run(serve(n_games=n_games, search="mc", samples=samples, depth=10, policy=3))
@@ -1,18 +1,37 @@
+import os
 from setuptools import setup
 from pybind11.setup_helpers import Pybind11Extension, build_ext
 
 __version__ = "0.0.1"
 
+# MCTS2048_STATS=1 pip install . builds the module with the search instrumentation (see include/Stats.h)
+define_macros = [("NDEBUG", None)]  # Disable debugging
+if os.environ.get("MCTS2048_STATS") == "1":
+    define_macros.append(("MCTS2048_STATS", "1"))
+
 ext_modules = [
     Pybind11Extension(
         'mcts2048',
         [
             'src/game.cpp',
+            'src/move_batch.cpp',
+            'src/heuristics.cpp',
+            'src/expectimax.cpp',
+            'src/mcts.cpp',
+            'src/features.cpp',
+            'src/network.cpp',
+            'src/ntuple.cpp',
+            'src/record_file.cpp',
+            'src/dataset_generator.cpp',
+            'src/stats.cpp',
+            'src/search_service.cpp',
+            'src/geometry.cpp',
+            'src/replay_buffer.cpp',
             'src/pybind.cpp',
         ],
         include_dirs=["include/"],
         language='c++',
-        define_macros=[("NDEBUG", None)],  # Disable debugging
+        define_macros=define_macros,
         extra_compile_args=[
             '-Wno-sign-compare',
             '-Wno-reorder',
@@ -26,6 +45,7 @@ ext_modules = [
         ],
         extra_link_args=[
             '-flto=auto',         # Enable Link-Time Optimization for linking
+            '-lrt',               # shm_open of the replay buffer, part of libc since glibc 2.34
         ],
     ),
 ]
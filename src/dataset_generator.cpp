@@ -0,0 +1,126 @@
+#include "DatasetGenerator.h"
+#include "game.h"
+#include "ThreadPool.h"
+#include "tables.h"
+#include "Random.h"
+#include <stdexcept>
+#include <string>
+
+DatasetGenerator::DatasetGenerator(const std::string& path, int samples, int depth, int policy, size_t chunk_records)
+    : file_path(path), samples(samples), depth(depth), policy(policy), chunk_records(chunk_records == 0 ? 1 : chunk_records) {
+}
+
+DatasetGenerator::DatasetGenerator(std::shared_ptr<ReplayBuffer> buffer, int samples, int depth, int policy, size_t chunk_records)
+    : DatasetGenerator(buffer->name(), samples, depth, policy, chunk_records) {
+    this->buffer = std::move(buffer);
+}
+
+uint64_t DatasetGenerator::run(uint64_t total_records) {
+    //resume: the writer keeps the complete records of an earlier run
+    if (!buffer) writer = std::make_unique<RecordWriter>(file_path, samples, depth, policy);
+    //records of other settings in one file make different targets, only a file of unknown or mixed
+    //settings (-1, like merge_record_files writes) takes records of any
+    if (writer) {
+        const RecordFileHeader header = writer->header();
+        const auto differs = [](int32_t stored, int setting) { return stored != -1 && stored != setting; };
+        if (differs(header.samples, samples) || differs(header.depth, depth) || differs(header.policy, policy)) {
+            writer.reset();
+            throw std::runtime_error(file_path + " holds records of samples " + std::to_string(header.samples) +
+                                     ", depth " + std::to_string(header.depth) + ", policy " + std::to_string(header.policy) +
+                                     ", not of samples " + std::to_string(samples) + ", depth " + std::to_string(depth) +
+                                     ", policy " + std::to_string(policy));
+        }
+    }
+    const uint64_t existing = writer ? writer->size() : 0;
+
+    records_reserved.store(existing);
+    records_written.store(existing);
+    games_started.store(0);
+    games_finished.store(0);
+    stopping.store(false);
+    write_failed.store(false);
+
+    //every game gets its own rng stream of the run seed, like the rollout chunks of compute_scores. the
+    //records already in the file go into the seed: a resumed run with the same seed plays new games
+    //instead of game 0, 1, ... of the first run again
+    uint64_t resume_point = existing;
+    const uint64_t run_seed = thread_rng().next64() ^ splitmix64(resume_point);
+    ThreadPool& pool = get_rollout_pool();
+    pool.parallel_for(pool.size(), [&](size_t) {
+        play(total_records, run_seed);
+    });
+
+    writer.reset();
+    if (write_failed.load()) throw std::runtime_error("writing to " + file_path + " failed");
+    return records_written.load();
+}
+
+void DatasetGenerator::play(uint64_t total_records, uint64_t run_seed) {
+    std::vector<SelfPlayRecord> chunk;
+    chunk.reserve(chunk_records);
+    bool full = false;
+
+    while (!full && !stopping.load()) {
+        seed_thread_rng(run_seed, games_started.fetch_add(1));
+        uint64_t board = new_game_board();
+        while (!is_game_over(board)) {
+            if (stopping.load()) break;
+            //claim the slot first, so that the workers together never write more than total_records
+            if (records_reserved.fetch_add(1) >= total_records) {
+                full = true;
+                break;
+            }
+
+            //rollouts for the legal moves only, 0 for the others. a single legal move needs no rollouts,
+            //it gets score 1, so that the scores still sum to more than 0 like the targets of train.py
+            const Successors next = successors(board);
+            const vector<uint> moves = get_possible_moves(board);
+            double scores[4] = {0, 0, 0, 0};
+            if (moves.size() == 1) {
+                scores[moves[0]] = 1;
+            } else {
+                const vector<double> move_scores = compute_scores(board, samples, depth, policy, moves);
+                for (size_t i = 0; i < moves.size(); ++i) scores[moves[i]] = move_scores[i];
+            }
+            unsigned best = 4;
+            for (uint direction : moves) {
+                if (best == 4 || scores[direction] > scores[best]) best = direction;
+            }
+
+            SelfPlayRecord record = {};
+            record.board = board;
+            for (int i = 0; i < 4; ++i) record.scores[i] = (float)scores[i];
+            record.move = (uint8_t)best;
+            record.reward = next.scores[best];
+            chunk.push_back(record);
+            if (chunk.size() >= chunk_records) append(chunk);
+
+            board = add_new_tile(next.boards[best]);
+        }
+        if (!full && is_game_over(board)) games_finished.fetch_add(1);
+    }
+    append(chunk);
+}
+
+void DatasetGenerator::append(std::vector<SelfPlayRecord>& chunk) {
+    if (chunk.empty()) return;
+    if (buffer) {
+        //lock free, the workers push side by side
+        buffer->push(chunk.data(), chunk.size());
+        records_written.fetch_add(chunk.size());
+        chunk.clear();
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(file_mutex);
+        try {
+            writer->append(chunk.data(), chunk.size());
+        } catch (const std::exception&) {
+            //disk full or similar, the workers cannot throw so run() reports it
+            write_failed.store(true);
+            stopping.store(true);
+        }
+        records_written.store(writer->size());
+    }
+    chunk.clear();
+}
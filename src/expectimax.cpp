@@ -0,0 +1,43 @@
+#include "game.h"
+#include "Geometry.h"
+#include "TranspositionTable.h"
+#include "Stats.h"
+#include <array>
+#include <vector>
+
+// Expectimax search. max nodes pick the best move, chance nodes average over every 2/4 spawn weighted
+// by its probability. a node is scored once the depth limit is reached or once the probability of
+// reaching it drops below min_probability: the n-tuple network if one is set, else the table evaluator.
+// the value of a move is the expected merge score along the way plus the leaf value. chance node values
+// are cached in the transposition table, keyed on the canonical form of the board and the remaining
+// depth: both leaf values are the same for all 8 symmetries of a board, so the symmetric positions share
+// one entry. the search itself is GeometryExpectimax on the default board (Geometry.h)
+TranspositionTable expectimax_table(20);
+
+void set_expectimax_table_size(int log2_entries) {
+    //must not be called while a search is running
+    expectimax_table.resize(log2_entries);
+}
+
+void clear_expectimax_table() {
+    expectimax_table.clear();
+}
+
+vector<double> compute_expectimax_scores(const uint64_t board, const int depth, const double min_probability) {
+    //returns the value of every move, 0 for moves that are not possible
+    SearchLatency latency(STAT_SEARCH_EXPECTIMAX);
+    const std::array<double, 4> scores = GeometryExpectimax<GeometryGame<DefaultGeometry>>::scores(board, depth, min_probability);
+    return vector<double>(scores.begin(), scores.end());
+}
+
+uint compute_expectimax_move(const uint64_t board, const int depth, const double min_probability) {
+    const vector<uint> moves = get_possible_moves(board);
+    if (moves.empty()) return 0; //game over, any move is a no-op
+    if (moves.size() == 1) return moves[0];
+    const vector<double> scores = compute_expectimax_scores(board, depth, min_probability);
+    uint best = moves[0];
+    for (uint direction : moves) {
+        if (scores[direction] > scores[best]) best = direction;
+    }
+    return best;
+}
@@ -0,0 +1,70 @@
+#include "game.h"
+#include "ThreadPool.h"
+#include "Network.h"
+#include <algorithm>
+#include <cstdint>
+
+// Network input features, the native version of preprocess_board in train.py. a cell with exponent e is
+// log2(e) (0 for empty cells, so a 2 tile also reads 0), divided by the largest value on the board.
+// then follow 12 vertical and 12 horizontal edges, 1 where the two neighbouring values are equal, and
+// 16 empty flags, 1 where the value is 0. the values match numpy bit for bit: log2 is numpy's float32
+// log2 and the division is done in double, which rounds to the same float as a float division
+
+// numpy.log2 of the exponents 0..15 as float32 (exponent 0 is an empty cell)
+static const float exponent_log2[16] = {
+    0.0f, 0x0.0p+0f, 0x1.0p+0f, 0x1.95c01ap+0f, 0x1.0p+1f, 0x1.2934f0p+1f, 0x1.4ae00cp+1f, 0x1.675768p+1f,
+    0x1.8p+1f, 0x1.95c01ap+1f, 0x1.a934f0p+1f, 0x1.bacea8p+1f, 0x1.cae00cp+1f, 0x1.d9a802p+1f, 0x1.e75768p+1f,
+    0x1.f414fep+1f,
+};
+
+// normalized_value[m][e]: value of exponent e on a board whose largest exponent is m
+struct NormalizedValues {
+    float value[16][16];
+
+    NormalizedValues() {
+        for (int m = 0; m < 16; ++m) {
+            for (int e = 0; e < 16; ++e) {
+                //a board of only 2 tiles has maximum 0, python divides by 0 there (NaN), we keep the 0
+                const double max_value = exponent_log2[m];
+                value[m][e] = max_value == 0 ? 0.0f : (float)((double)exponent_log2[e] / max_value);
+            }
+        }
+    }
+};
+
+static const NormalizedValues normalized_value;
+
+void board_features(uint64_t board, float* out) {
+    uint8_t rank[16];
+    uint8_t max_rank = 0;
+    for (int i = 0; i < 16; ++i) {
+        rank[i] = (uint8_t)((board >> (i * 4)) & 0xF);
+        max_rank = std::max(max_rank, rank[i]);
+    }
+    //empty and 2 tiles both have the value 0
+    uint8_t value_class[16];
+    for (int i = 0; i < 16; ++i) value_class[i] = rank[i] <= 1 ? 0 : rank[i];
+
+    const float* values = normalized_value.value[max_rank];
+    for (int i = 0; i < 16; ++i) out[i] = values[rank[i]];
+    //vertical edges, cell (row, col) against (row + 1, col)
+    for (int i = 0; i < 12; ++i) out[16 + i] = value_class[i] == value_class[i + 4] ? 1.0f : 0.0f;
+    //horizontal edges, cell (row, col) against (row, col + 1)
+    for (int row = 0; row < 4; ++row) {
+        for (int col = 0; col < 3; ++col) {
+            out[28 + row * 3 + col] = value_class[row * 4 + col] == value_class[row * 4 + col + 1] ? 1.0f : 0.0f;
+        }
+    }
+    for (int i = 0; i < 16; ++i) out[40 + i] = value_class[i] == 0 ? 1.0f : 0.0f;
+}
+
+const size_t feature_chunk_size = 1024;
+
+void extract_features(const uint64_t* boards, float* features, size_t n) {
+    const size_t n_chunks = (n + feature_chunk_size - 1) / feature_chunk_size;
+    get_rollout_pool().parallel_for(n_chunks, [&](size_t chunk) {
+        const size_t begin = chunk * feature_chunk_size;
+        const size_t end = std::min(n, begin + feature_chunk_size);
+        for (size_t i = begin; i < end; ++i) board_features(boards[i], features + i * n_features);
+    });
+}
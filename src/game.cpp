@@ -1,28 +1,85 @@
 #include "game.h"
-//#include "LRUCache.h"
+#include "ThreadPool.h"
+#include "tables.h"
+#include "Random.h"
+#include "policies.h"
+#include "Stats.h"
 #include <array>
 #include <random>
 #include <iostream>
 #include <stdexcept>
 #include <tuple>
 #include <cstdint>
-
-// Random number generator for adding tiles
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Random number generators. every thread has its own, so rollouts can run in parallel without
+// sharing generator state. threads (re)seed themselves lazily from the global seed whenever it changes
 std::random_device rd;
-std::mt19937 rng(rd());
-std::uniform_real_distribution<double> dist(0.0, 1.0);
+std::atomic<uint64_t> rng_seed(((uint64_t)rd() << 32) | rd());
+std::atomic<uint64_t> rng_generation(1);
+std::atomic<uint64_t> rng_stream_counter(1);
+
+struct ThreadRng {
+    Rng rng;
+    uint64_t generation = 0;
+};
+
+thread_local ThreadRng thread_rng_state;
+
+Rng& thread_rng() {
+    ThreadRng& state = thread_rng_state;
+    const uint64_t generation = rng_generation.load(std::memory_order_relaxed);
+    if (state.generation != generation) {
+        state.rng.seed(rng_seed.load(std::memory_order_relaxed), rng_stream_counter.fetch_add(1));
+        state.generation = generation;
+    }
+    return state.rng;
+}
+
+void seed_thread_rng(uint64_t seed, uint64_t stream) {
+    thread_rng_state.rng.seed(seed, stream);
+    thread_rng_state.generation = rng_generation.load(std::memory_order_relaxed);
+}
 
-uint16_t move_result_left[65536];
-unsigned move_score_left[65536];
+void set_seed(uint64_t seed) {
+    //must not be called while a search is running
+    rng_seed.store(seed);
+    rng_stream_counter.store(1);
+    rng_generation.fetch_add(1);
+    seed_thread_rng(seed, 0);
+}
+
+// Worker pool for the rollouts in compute_scores
+unique_ptr<ThreadPool> rollout_pool;
+std::mutex rollout_pool_mutex;
+
+ThreadPool& get_rollout_pool() {
+    std::lock_guard<std::mutex> lock(rollout_pool_mutex);
+    if (!rollout_pool) {
+        rollout_pool = make_unique<ThreadPool>(std::max(1u, std::thread::hardware_concurrency()));
+    }
+    return *rollout_pool;
+}
 
-uint16_t move_result_right[65536];
-unsigned move_score_right[65536];
+void set_num_threads(int n_threads) {
+    //must not be called while a search is running
+    if (n_threads <= 0) n_threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    std::lock_guard<std::mutex> lock(rollout_pool_mutex);
+    rollout_pool.reset();
+    rollout_pool = make_unique<ThreadPool>((size_t)n_threads);
+}
 
-uint16_t move_result_up[65536];
-unsigned move_score_up[65536];
+int get_num_threads() {
+    return (int)get_rollout_pool().size();
+}
 
-uint16_t move_result_down[65536];
-unsigned move_score_down[65536];
+uint32_t move_table_left[65536];
+uint32_t move_table_right[65536];
 
 inline uint16_t reverse_nibbles(uint16_t val) {
     return ((val & 0xF) << 12) |
@@ -31,7 +88,9 @@ inline uint16_t reverse_nibbles(uint16_t val) {
            ((val & 0xF000) >> 12);
 }
 
-void initialize_tables() {
+// Fills the move tables. runs once while the library is loaded, before any thread of ours exists,
+// so the tables are ready before the first call and never written afterwards
+static bool fill_move_tables() {
     for (uint32_t row = 0; row < 65536; ++row) {
         uint16_t c0 = (row >>  0) & 0xF;
         uint16_t c1 = (row >>  4) & 0xF;
@@ -47,7 +106,8 @@ void initialize_tables() {
 
         unsigned score = 0;
         for (int i = 0; i < 3; ++i) {
-            if (filtered[i] != 0 && filtered[i] == filtered[i + 1]) {
+            //two 32768 tiles would merge to exponent 16, which a nibble cannot hold, so they stay apart
+            if (filtered[i] != 0 && filtered[i] != 15 && filtered[i] == filtered[i + 1]) {
                 filtered[i]++;
                 score += (1U << filtered[i]);
                 // Shift tiles after position i
@@ -63,34 +123,22 @@ void initialize_tables() {
                          | ((filtered[2] & 0xF) << 8)
                          | ((filtered[3] & 0xF) << 12);
 
-        move_result_left[row] = new_row;
-        move_score_left[row] = score;
+        move_table_left[row] = new_row | ((score >> 2) << 16);
     }
 
+    //moving right is moving left on the mirrored row
     for (uint32_t row = 0; row < 65536; ++row) {
-        uint16_t reversed = reverse_nibbles((uint16_t)row);
-        uint16_t res = move_result_left[reversed];
-        unsigned scr = move_score_left[reversed];
-        uint16_t final_res = reverse_nibbles(res);
-
-        move_result_right[row] = final_res;
-        move_score_right[row] = scr;
+        const uint32_t entry = move_table_left[reverse_nibbles((uint16_t)row)];
+        move_table_right[row] = reverse_nibbles(move_table_result(entry)) | (entry & 0xFFFF0000u);
     }
+    return true;
+}
 
-    for (uint32_t col = 0; col < 65536; ++col) {
-        uint16_t up_res = move_result_left[col];
-        unsigned up_scr = move_score_left[col];
-        move_result_up[col] = up_res;
-        move_score_up[col] = up_scr;
-
-        uint16_t reversed = reverse_nibbles((uint16_t)col);
-        uint16_t res = move_result_left[reversed];
-        unsigned scr = move_score_left[reversed];
-        uint16_t final_res = reverse_nibbles(res);
+static const bool move_tables_filled = fill_move_tables();
 
-        move_result_down[col] = final_res;
-        move_score_down[col] = scr;
-    }
+void initialize_tables() {
+    //the move and heuristic tables are filled when the library is loaded, kept so that existing
+    //callers keep working
 }
 
 // Check if a move in the given direction is possible
@@ -102,120 +150,36 @@ bool can_move(uint64_t board, int direction) {
 
 // Check if the board is in a game over state
 bool is_game_over(uint64_t board) {
-    for (int direction = 0; direction < 4; ++direction) {
-        if (can_move(board, direction)) return false;
-    }
-    return true;
+    return successors(board).legal == 0;
 }
 
 // Add a new tile (2 or 4) to the board
 uint64_t add_new_tile(uint64_t board) {
-    std::vector<int> empty_positions;
-    for (int i = 0; i < 16; ++i) {
-        if (((board >> (i * 4)) & 0xF) == 0) {
-            empty_positions.push_back(i);
-        }
-    }
-
-    if (empty_positions.empty()) return board; // No space to add a tile
-
-    int pos = empty_positions[rng() % empty_positions.size()];
-    uint16_t new_tile = (dist(rng) < 0.9) ? 1 : 2; // 2 with 90%, 4 with 10%
-
-    return board | ((uint64_t)new_tile << (pos * 4));
+    return spawn_tile(board, thread_rng());
 }
 
 
-inline std::tuple<uint64_t, unsigned> move(uint64_t board, int direction) {
+tuple<uint64_t, uint> move(uint64_t board, int direction) {
+    //up and down work on the transposed board, so all four directions cost 4 row lookups
     unsigned out_score = 0;
     uint64_t new_board = 0;
 
     switch (direction) {
-        case 0: { // Left
-            {
-                uint16_t line = (uint16_t)((board >> 0) & 0xFFFF);
-                new_board |= ((uint64_t)move_result_left[line]) << 0;
-                out_score += move_score_left[line];
-            }
-            {
-                uint16_t line = (uint16_t)((board >> 16) & 0xFFFF);
-                new_board |= ((uint64_t)move_result_left[line]) << 16;
-                out_score += move_score_left[line];
-            }
-            {
-                uint16_t line = (uint16_t)((board >> 32) & 0xFFFF);
-                new_board |= ((uint64_t)move_result_left[line]) << 32;
-                out_score += move_score_left[line];
-            }
-            {
-                uint16_t line = (uint16_t)((board >> 48) & 0xFFFF);
-                new_board |= ((uint64_t)move_result_left[line]) << 48;
-                out_score += move_score_left[line];
-            }
+        case 0: // Left
+            new_board = move_rows(board, move_table_left, out_score);
             break;
-        }
 
-        case 1: { // Right
-            {
-                uint16_t line = (uint16_t)((board >> 0) & 0xFFFF);
-                new_board |= ((uint64_t)move_result_right[line]) << 0;
-                out_score += move_score_right[line];
-            }
-            {
-                uint16_t line = (uint16_t)((board >> 16) & 0xFFFF);
-                new_board |= ((uint64_t)move_result_right[line]) << 16;
-                out_score += move_score_right[line];
-            }
-            {
-                uint16_t line = (uint16_t)((board >> 32) & 0xFFFF);
-                new_board |= ((uint64_t)move_result_right[line]) << 32;
-                out_score += move_score_right[line];
-            }
-            {
-                uint16_t line = (uint16_t)((board >> 48) & 0xFFFF);
-                new_board |= ((uint64_t)move_result_right[line]) << 48;
-                out_score += move_score_right[line];
-            }
+        case 1: // Right
+            new_board = move_rows(board, move_table_right, out_score);
             break;
-        }
 
-        case 2: { // Up
-            for (int i = 0; i < 4; ++i) {
-                uint16_t line =
-                    ((board >> (i*4)) & 0xF) |
-                    (((board >> (16 + i*4)) & 0xF) << 4) |
-                    (((board >> (32 + i*4)) & 0xF) << 8) |
-                    (((board >> (48 + i*4)) & 0xF) << 12);
-
-                uint16_t result = move_result_up[line];
-                out_score += move_score_up[line];
-
-                new_board |= ((uint64_t)(result & 0xF) << (i*4));
-                new_board |= ((uint64_t)((result >> 4) & 0xF) << (16 + i*4));
-                new_board |= ((uint64_t)((result >> 8) & 0xF) << (32 + i*4));
-                new_board |= ((uint64_t)((result >> 12) & 0xF) << (48 + i*4));
-            }
+        case 2: // Up
+            new_board = transpose(move_rows(transpose(board), move_table_left, out_score));
             break;
-        }
 
-        case 3: { // Down
-            for (int i = 0; i < 4; ++i) {
-                uint16_t line =
-                    ((board >> (i*4)) & 0xF) |
-                    (((board >> (16 + i*4)) & 0xF) << 4) |
-                    (((board >> (32 + i*4)) & 0xF) << 8) |
-                    (((board >> (48 + i*4)) & 0xF) << 12);
-
-                uint16_t result = move_result_down[line];
-                out_score += move_score_down[line];
-
-                new_board |= ((uint64_t)(result & 0xF) << (i*4));
-                new_board |= ((uint64_t)((result >> 4) & 0xF) << (16 + i*4));
-                new_board |= ((uint64_t)((result >> 8) & 0xF) << (32 + i*4));
-                new_board |= ((uint64_t)((result >> 12) & 0xF) << (48 + i*4));
-            }
+        case 3: // Down
+            new_board = transpose(move_rows(transpose(board), move_table_right, out_score));
             break;
-        }
 
         default:
             return std::make_tuple(board, 0U);
@@ -225,19 +189,9 @@ inline std::tuple<uint64_t, unsigned> move(uint64_t board, int direction) {
 }
 
 tuple<uint64_t, uint> cached_move(uint64_t board, int direction) {
-    /*LRUCache::Key key = {board, direction}; //actually slower! so we will not use this
-
-    if (lruCache.contains(key)) {
-        // Return cached result
-        return lruCache.get(key);
-    }*/
-
-    auto val = move(board, direction);
-
-    // Cache the result
-    //lruCache.put(key, val);
-
-    return val;
+    //a single move is 4 table lookups, caching it does not pay off. search results are cached in the
+    //transposition table of the expectimax search instead
+    return move(board, direction);
 }
 
 void print_board(uint64_t board) {
@@ -256,160 +210,101 @@ void print_board(uint64_t board) {
 }
 
 vector<uint> get_possible_moves(uint64_t board) {
+    const unsigned legal = successors(board).legal;
     vector<uint> moves;
     for (uint i = 0; i < 4; ++i) {
-        if (can_move(board, i)) {
+        if (legal & (1u << i)) {
             moves.push_back(i);
         }
     }
     return moves;
 }
 
-uint count_zeros(uint64_t board) {
-    uint count = 0;
-    for (int i = 0; i < 16; ++i) {
-        if (((board >> (i * 4)) & 0xF) == 0) {
-            count++;
-        }
+// Policy dispatch. the policies live in policies.h, every loop below is instantiated once per policy
+// and the policy number is resolved once per call through the tables
+struct ChooseMove {
+    template <typename Policy>
+    static uint run(const Successors& next, Rng& rng) {
+        return choose_with<Policy>(next, rng);
     }
-    return count;
-}
-
-uint count_min_adjacent_diff(uint64_t board) {
-    uint16_t tiles[4][4];
+};
 
-    // Pre-extract all tile values
-    for (int i = 0; i < 4; ++i) {
-        for (int j = 0; j < 4; ++j) {
-            tiles[i][j] = (board >> (i * 16 + j * 4)) & 0xF;
+// Sum of count rollouts from the semi-state after a move
+struct RolloutSum {
+    template <typename Policy>
+    static double run(uint64_t base_board, uint base_score, int depth, int count, Rng& rng) {
+        double sum = 0;
+        for (int j = 0; j < count; ++j) {
+            //add a new random tile, completing the first move, then play on with the policy
+            sum += base_score + play_out<Policy>(spawn_tile(base_board, rng), depth, rng);
         }
+        return sum;
     }
+};
 
-    uint diff_sum = 0;
-
-    for (int i = 0; i < 4; ++i) {
-        for (int j = 0; j < 4; ++j) {
-            int tile = (int)tiles[i][j];
-            int min_diff = 16; // max difference for nibble-sized values is 15
-
-            // Check up
-            if (i > 0) {
-                int diff = tile - (int)tiles[i - 1][j];
-                if (diff < 0) diff = -diff;
-                if (diff < min_diff) min_diff = diff;
-            }
-
-            // Check down
-            if (i < 3) {
-                int diff = tile - (int)tiles[i + 1][j];
-                if (diff < 0) diff = -diff;
-                if (diff < min_diff) min_diff = diff;
-            }
-
-            // Check left
-            if (j > 0) {
-                int diff = tile - (int)tiles[i][j - 1];
-                if (diff < 0) diff = -diff;
-                if (diff < min_diff) min_diff = diff;
+// Sum and sum of squares of count rollouts, for the running mean and variance of the adaptive search
+struct RolloutMoments {
+    template <typename Policy>
+    static std::pair<double, double> run(uint64_t base_board, uint base_score, int depth, int count, Rng& rng) {
+        double sum = 0;
+        double sum_squares = 0;
+        for (int j = 0; j < count; ++j) {
+            const double value = base_score + play_out<Policy>(spawn_tile(base_board, rng), depth, rng);
+            sum += value;
+            sum_squares += value * value;
+        }
+        return {sum, sum_squares};
+    }
+};
+
+// Sums of the paired rollouts of the samples [begin, end): every sample plays the rollouts of all possible
+// moves from the same counter based stream, stream j of the call seed for sample j
+struct PairedSums {
+    double sum[4];
+    double sum_squares[4];
+    double difference_sum[4][4];      // [a][b] for a < b: sum of value a - value b
+    double difference_squares[4][4];
+};
+
+struct PairedRollouts {
+    template <typename Policy>
+    static void run(const Successors& next, uint64_t call_seed, int begin, int end, int depth, PairedSums& sums) {
+        for (int j = begin; j < end; ++j) {
+            CounterRng rng(call_seed, (uint64_t)j);
+            double values[4] = {0, 0, 0, 0};
+            for (uint direction = 0; direction < 4; ++direction) {
+                if (!(next.legal & (1u << direction))) continue;
+                values[direction] = next.scores[direction] + play_out_common<Policy>(spawn_tile_common(next.boards[direction], 0, rng), depth, rng);
+                sums.sum[direction] += values[direction];
+                sums.sum_squares[direction] += values[direction] * values[direction];
             }
-
-            // Check right
-            if (j < 3) {
-                int diff = tile - (int)tiles[i][j + 1];
-                if (diff < 0) diff = -diff;
-                if (diff < min_diff) min_diff = diff;
+            for (uint a = 0; a < 4; ++a) {
+                if (!(next.legal & (1u << a))) continue;
+                for (uint b = a + 1; b < 4; ++b) {
+                    if (!(next.legal & (1u << b))) continue;
+                    const double difference = values[a] - values[b];
+                    sums.difference_sum[a][b] += difference;
+                    sums.difference_squares[a][b] += difference * difference;
+                }
             }
-
-            diff_sum += min_diff;
         }
     }
+};
 
-    return diff_sum;
-}
+const auto choose_move_table = make_policy_table<ChooseMove>();
+const auto rollout_sum_table = make_policy_table<RolloutSum>();
+const auto rollout_moments_table = make_policy_table<RolloutMoments>();
+const auto paired_rollouts_table = make_policy_table<PairedRollouts>();
 
+// Picks a move from the successors of a board, expects at least one legal move
+uint choose_move(const Successors& next, int policy) {
+    return policy_entry(choose_move_table, policy)(next, thread_rng());
+}
 
 uint compute_simple_best_move(uint64_t board, int policy) {
-    if(policy == 0){ //avg score: 4100
-        uint lowest_score = 0;
-        uint best_direction = 4;
-        const vector<uint> moves = get_possible_moves(board);
-        if(moves.size() == 1){
-            return moves[0];
-        }
-        for (uint i = 0; i < moves.size(); ++i) {
-            uint direction = moves[i];
-            auto [new_board, unused] = cached_move(board, direction);
-            uint score = count_min_adjacent_diff(new_board);
-            if (i == 0 || score < lowest_score) {
-                lowest_score = score;
-                best_direction = direction;
-            }
-        }
-        return best_direction;
-    } else if (policy == 1){ //avg score: 2980
-        uint highest_score = 0;
-        uint best_direction = 4;
-        const vector<uint> moves = get_possible_moves(board);
-        if(moves.size() == 1){
-            return moves[0];
-        }
-        for (uint i = 0; i < moves.size(); ++i) {
-            uint direction = moves[i];
-            auto [new_board, unused] = cached_move(board, direction);
-            uint score = count_zeros(new_board);
-            if (i == 0 || score > highest_score) {
-                highest_score = score;
-                best_direction = direction;
-            }
-        }
-        return best_direction;
-    } else if (policy == 2){ //avg score: 830
-        //just use the first possible direction
-        return get_possible_moves(board)[0];
-    } else if (policy == 3){ //avg score
-        //randomly choose a direction
-        return get_possible_moves(board)[rng() % get_possible_moves(board).size()];
-    } else if (policy == 4){
-        //use policy 0, but use the scores as probabilities
-        vector<uint> moves = get_possible_moves(board);
-        if(moves.size() == 1){
-            return moves[0];
-        }
-        vector<double> scores;
-        for (uint i = 0; i < moves.size(); ++i) {
-            uint direction = moves[i];
-            auto [new_board, unused] = cached_move(board, direction);
-            uint score = count_min_adjacent_diff(new_board);
-            scores.push_back(score);
-        }
-        //get the maximum score
-        double max_score = *max_element(scores.begin(), scores.end());
-        //subtract the maximum score from all scores
-        for (int i = 0; i < scores.size(); i++) {
-            scores[i] = max_score - scores[i]; //invert the scores - the higher the score, the lower the value
-        }
-        //normalize the scores
-        double sum = 0;
-        for (int i = 0; i < scores.size(); i++) {
-            sum += scores[i];
-        }
-        for (int i = 0; i < scores.size(); i++) {
-            scores[i] /= sum;
-        }
-        //now we have a probability distribution, we can sample from it
-        double r = dist(rng);
-        double sum2 = 0;
-        for (int i = 0; i < scores.size(); i++) {
-            sum2 += scores[i];
-            if (r < sum2) {
-                return moves[i];
-            }
-        }
-        return moves[0]; //should never happen
-
-    } else { //default policy: return the first possible direction
-        return get_possible_moves(board)[0];
-    }
+    const Successors next = successors(board);
+    if (next.legal == 0) return 0; //game over, any move is a no-op
+    return choose_move(next, policy);
 }
 
 
@@ -417,41 +312,54 @@ uint compute_best_move(const uint64_t board, const int samples, const int depth,
     //this works by doing a mtcs search on the board
     //first we determine all possible moves
     vector<uint> moves = get_possible_moves(board);
+    //game over, any move is a no-op
+    if (moves.empty()) return 0;
     //if there is only one move possible we return that move
     if (moves.size() == 1) return moves[0];
-    //no need to handle the case where there are no moves possible
     //so now we start the search
     //we will do 1000 simulations for each move with a maximum of 1000 moves each
     vector<double> scores = compute_scores(board, samples, depth, policy, moves);
     return moves[std::distance(scores.begin(), std::max_element(scores.begin(), scores.end()))];
 }
 
+double rollout(const uint64_t base_board, const uint base_score, const int depth, const int policy) {
+    //plays one random game continuation from the semi-state after a move and returns the score it reached
+    return policy_entry(rollout_sum_table, policy)(base_board, base_score, depth, 1, thread_rng());
+}
+
+const int rollout_chunk_size = 32;
+const int adaptive_first_round = 64;
+
 vector<double> compute_scores(const uint64_t board, const int samples, const int depth, const int policy, vector<uint> moves) {
+    SearchLatency latency(STAT_SEARCH_ROLLOUT);
     //this works by doing a mtcs search on the board
     //if there is only one move possible we return that move
     if (moves.size() == 1) return {0};
     //no need to handle the case where there are no moves possible
     //so now we start the search
-    //we will do 1000 simulations for each move with a maximum of 1000 moves each
+    //the samples of every move are split into chunks of rollout_chunk_size, and the chunks are spread over
+    //the worker pool. every chunk draws from its own rng stream, derived from the generator of the calling
+    //thread, so the result only depends on the seed and not on the number of threads or the scheduling.
+    //the partial sums are reduced per move afterwards
+    const int chunks = std::max(1, (samples + rollout_chunk_size - 1) / rollout_chunk_size);
+    const uint64_t call_seed = thread_rng().next64();
+    const auto rollout_sum = policy_entry(rollout_sum_table, policy);
+    vector<double> partial(moves.size() * chunks, 0.0);
+    get_rollout_pool().parallel_for(partial.size(), [&](size_t task) {
+        const uint direction = moves[task / chunks];
+        const int chunk = task % chunks;
+        const int begin = std::min(samples, chunk * rollout_chunk_size);
+        const int end = std::min(samples, begin + rollout_chunk_size);
+        seed_thread_rng(call_seed, task);
+        const auto [base_board, base_score] = cached_move(board, direction); //semi-state after moving, before sampling a new tile
+        partial[task] = rollout_sum(base_board, base_score, depth, end - begin, thread_rng());
+    });
+
     vector<double> scores;
     for (int i = 0; i < moves.size(); i++) {
-        const uint direction = moves[i];
-        const auto [base_board, base_score] = cached_move(board, direction); //semi-state after moving, before sampling a new tile
         double overall_score = 0;
-        for(int j = 0; j < samples; j++){
-            uint current_score = base_score;
-            uint score_add = 0;
-            uint64_t current_board = add_new_tile(base_board); //add a new random tile, completing the first move
-            for(int k = 0; k < depth; k++){
-                if(is_game_over(current_board)) break;
-
-                const uint direction = compute_simple_best_move(current_board, policy); //policy 4 is random, but guided. should be best.
-                tie(current_board, score_add) = cached_move(current_board, direction);
-
-                current_score += score_add;
-                current_board = add_new_tile(current_board);
-            }
-            overall_score += current_score;
+        for (int c = 0; c < chunks; c++) {
+            overall_score += partial[i * chunks + c];
         }
         scores.push_back(overall_score);
     }
@@ -474,6 +382,205 @@ vector<double> py_compute_scores(const uint64_t board, const int samples, const
     return ret;
 }
 
+AdaptiveScores compute_adaptive_scores(const uint64_t board, const int samples, const int depth, const int policy, const double z) {
+    SearchLatency latency(STAT_SEARCH_ROLLOUT);
+    //successive halving with a confidence bound stop. every round doubles the rollouts of the moves that are
+    //still in the race (the first round plays adaptive_first_round each), then drops every move whose upper
+    //confidence bound is below the lower bound of the best mean. a move never gets more than samples rollouts,
+    //so the worst case is the cost of compute_scores. like there, every chunk of rollouts has its own rng
+    //stream of the call seed, the stream number only depends on the move and the chunk
+    AdaptiveScores result = {};
+    const Successors next = successors(board);
+    result.best_move = next.legal == 0 ? 0 : first_move(next.legal);
+    if ((next.legal & (next.legal - 1)) == 0) return result; //at most one move, nothing to decide
+
+    const uint64_t call_seed = thread_rng().next64();
+    const auto rollout_moments = policy_entry(rollout_moments_table, policy);
+    double sum[4] = {0, 0, 0, 0};
+    double sum_squares[4] = {0, 0, 0, 0};
+    unsigned alive = next.legal;
+
+    struct Chunk {
+        uint direction;
+        int begin;
+        int count;
+        double sum;
+        double sum_squares;
+    };
+    vector<Chunk> chunks;
+    while (true) {
+        chunks.clear();
+        for (uint direction = 0; direction < 4; ++direction) {
+            if (!(alive & (1u << direction))) continue;
+            const int count = result.counts[direction];
+            const int end = std::min(samples, count + std::max(count, adaptive_first_round));
+            for (int begin = count; begin < end; begin += rollout_chunk_size) {
+                chunks.push_back({direction, begin, std::min(rollout_chunk_size, end - begin), 0, 0});
+            }
+        }
+        if (chunks.empty()) break; //every remaining move has all its samples
+
+        get_rollout_pool().parallel_for(chunks.size(), [&](size_t task) {
+            Chunk& chunk = chunks[task];
+            seed_thread_rng(call_seed, ((uint64_t)chunk.direction << 32) | (uint64_t)(chunk.begin / rollout_chunk_size));
+            std::tie(chunk.sum, chunk.sum_squares) = rollout_moments(next.boards[chunk.direction], next.scores[chunk.direction],
+                                                                     depth, chunk.count, thread_rng());
+        });
+        for (const Chunk& chunk : chunks) {
+            sum[chunk.direction] += chunk.sum;
+            sum_squares[chunk.direction] += chunk.sum_squares;
+            result.counts[chunk.direction] += chunk.count;
+            result.rollouts += chunk.count;
+        }
+
+        uint best = 4;
+        for (uint direction = 0; direction < 4; ++direction) {
+            if (!(alive & (1u << direction))) continue;
+            const double n = result.counts[direction];
+            const double mean = sum[direction] / n;
+            const double variance = n > 1 ? std::max(0.0, (sum_squares[direction] - n * mean * mean) / (n - 1)) : 0.0;
+            result.means[direction] = mean;
+            result.half_widths[direction] = z * std::sqrt(variance / n);
+            if (best == 4 || mean > result.means[best]) best = direction;
+        }
+        result.best_move = best;
+        const double best_lower = result.means[best] - result.half_widths[best];
+        for (uint direction = 0; direction < 4; ++direction) {
+            if ((alive & (1u << direction)) && result.means[direction] + result.half_widths[direction] < best_lower) {
+                alive &= ~(1u << direction);
+            }
+        }
+        if ((alive & (alive - 1)) == 0) break; //the best move is separated from all others
+    }
+    return result;
+}
+
+uint compute_adaptive_best_move(const uint64_t board, const int samples, const int depth, const int policy, const double z) {
+    return compute_adaptive_scores(board, samples, depth, policy, z).best_move;
+}
+
+const int timed_batch_size = 8;
+
+TimedScores compute_timed_scores(const uint64_t board, const int64_t budget_us, const int depth, const int policy) {
+    SearchLatency latency(STAT_SEARCH_ROLLOUT);
+    //every worker plays batches of rollouts until the deadline, the batches go round robin over the possible
+    //moves so that they all get about the same number of rollouts. the clock is read before every rollout,
+    //so the search ends at most one rollout after the deadline. batch b has rng stream b of the call seed
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::microseconds(std::max<int64_t>(0, budget_us));
+    TimedScores result = {};
+    const Successors next = successors(board);
+    result.best_move = next.legal == 0 ? 0 : first_move(next.legal);
+    if ((next.legal & (next.legal - 1)) != 0) {
+        uint moves[4];
+        int n_moves = 0;
+        for (uint direction = 0; direction < 4; ++direction) {
+            if (next.legal & (1u << direction)) moves[n_moves++] = direction;
+        }
+        const uint64_t call_seed = thread_rng().next64();
+        const auto rollout_sum = policy_entry(rollout_sum_table, policy);
+        std::atomic<uint64_t> next_batch(0);
+        std::mutex merge_mutex;
+        double sum[4] = {0, 0, 0, 0};
+        ThreadPool& pool = get_rollout_pool();
+        pool.parallel_for(pool.size(), [&](size_t) {
+            double local_sum[4] = {0, 0, 0, 0};
+            int local_count[4] = {0, 0, 0, 0};
+            while (std::chrono::steady_clock::now() < deadline) {
+                const uint64_t batch = next_batch.fetch_add(1);
+                const uint direction = moves[batch % n_moves];
+                seed_thread_rng(call_seed, batch);
+                Rng& rng = thread_rng();
+                for (int j = 0; j < timed_batch_size && (j == 0 || std::chrono::steady_clock::now() < deadline); ++j) {
+                    local_sum[direction] += rollout_sum(next.boards[direction], next.scores[direction], depth, 1, rng);
+                    local_count[direction]++;
+                }
+            }
+            std::lock_guard<std::mutex> lock(merge_mutex);
+            for (int d = 0; d < 4; ++d) {
+                sum[d] += local_sum[d];
+                result.counts[d] += local_count[d];
+            }
+        });
+
+        bool found = false;
+        for (int i = 0; i < n_moves; ++i) {
+            const uint direction = moves[i];
+            result.rollouts += result.counts[direction];
+            if (result.counts[direction] == 0) continue;
+            result.means[direction] = sum[direction] / result.counts[direction];
+            if (!found || result.means[direction] > result.means[result.best_move]) {
+                result.best_move = direction;
+                found = true;
+            }
+        }
+    }
+    result.elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+uint compute_timed_best_move(const uint64_t board, const int64_t budget_us, const int depth, const int policy) {
+    return compute_timed_scores(board, budget_us, depth, policy).best_move;
+}
+
+PairedScores compute_paired_scores(const uint64_t board, const int samples, const int depth, const int policy) {
+    SearchLatency latency(STAT_SEARCH_ROLLOUT);
+    //common random numbers: sample j of every move replays the same draws, so the luck that a sample's
+    //rollouts share cancels out of the differences between the moves (see PairedScores). the samples are
+    //split into chunks of rollout_chunk_size over the worker pool, the streams only depend on the call
+    //seed and the sample, so the result does not depend on the threads
+    PairedScores result = {};
+    const Successors next = successors(board);
+    result.best_move = next.legal == 0 ? 0 : first_move(next.legal);
+    if ((next.legal & (next.legal - 1)) == 0 || samples <= 0) return result; //at most one move, nothing to decide
+
+    const int chunks = (samples + rollout_chunk_size - 1) / rollout_chunk_size;
+    const uint64_t call_seed = thread_rng().next64();
+    const auto paired_rollouts = policy_entry(paired_rollouts_table, policy);
+    vector<PairedSums> partial(chunks, PairedSums{});
+    get_rollout_pool().parallel_for(chunks, [&](size_t chunk) {
+        const int begin = (int)chunk * rollout_chunk_size;
+        paired_rollouts(next, call_seed, begin, std::min(samples, begin + rollout_chunk_size), depth, partial[chunk]);
+    });
+    PairedSums sums = {};
+    for (const PairedSums& p : partial) {
+        for (int a = 0; a < 4; ++a) {
+            sums.sum[a] += p.sum[a];
+            sums.sum_squares[a] += p.sum_squares[a];
+            for (int b = 0; b < 4; ++b) {
+                sums.difference_sum[a][b] += p.difference_sum[a][b];
+                sums.difference_squares[a][b] += p.difference_squares[a][b];
+            }
+        }
+    }
+
+    //mean and standard error of a sum of n values and of their squares
+    const double n = samples;
+    auto standard_error = [n](double sum, double sum_squares) {
+        const double mean = sum / n;
+        return n > 1 ? std::sqrt(std::max(0.0, (sum_squares - n * mean * mean) / (n - 1)) / n) : 0.0;
+    };
+    result.samples = samples;
+    for (uint a = 0; a < 4; ++a) {
+        if (!(next.legal & (1u << a))) continue;
+        result.means[a] = sums.sum[a] / n;
+        result.std_errors[a] = standard_error(sums.sum[a], sums.sum_squares[a]);
+        if (result.means[a] > result.means[result.best_move]) result.best_move = a;
+        for (uint b = a + 1; b < 4; ++b) {
+            if (!(next.legal & (1u << b))) continue;
+            result.differences[a][b] = sums.difference_sum[a][b] / n;
+            result.differences[b][a] = -result.differences[a][b];
+            result.difference_errors[a][b] = standard_error(sums.difference_sum[a][b], sums.difference_squares[a][b]);
+            result.difference_errors[b][a] = result.difference_errors[a][b];
+        }
+    }
+    return result;
+}
+
+uint compute_paired_best_move(const uint64_t board, const int samples, const int depth, const int policy) {
+    return compute_paired_scores(board, samples, depth, policy).best_move;
+}
+
 vector<vector<uint>> board_to_array(const uint64_t board) {
     //this function converts the board to a 4x4 array
     vector<vector<uint>> ret;
@@ -486,3 +593,98 @@ vector<vector<uint>> board_to_array(const uint64_t board) {
     }
     return ret;
 }
+
+uint64_t new_game_board() {
+    //empty board with the 2 starting tiles
+    return add_new_tile(add_new_tile(0));
+}
+
+// Batched environment. all functions work in place on flat arrays of n boards, the pybind layer
+// hands over the numpy buffers directly. boards are processed in chunks on the rollout pool
+const size_t env_chunk_size = 1024;
+
+template <typename F>
+void for_each_chunk(size_t n, F&& fn) {
+    //like the rollouts, every chunk gets its own rng stream so that the result does not depend on the scheduling
+    const size_t n_chunks = (n + env_chunk_size - 1) / env_chunk_size;
+    const uint64_t call_seed = thread_rng().next64();
+    get_rollout_pool().parallel_for(n_chunks, [&](size_t chunk) {
+        seed_thread_rng(call_seed, chunk);
+        const size_t begin = chunk * env_chunk_size;
+        const size_t end = std::min(n, begin + env_chunk_size);
+        fn(begin, end);
+    });
+}
+
+void reset_boards(uint64_t* boards, size_t n) {
+    for_each_chunk(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) boards[i] = new_game_board();
+    });
+}
+
+void step_boards(uint64_t* boards, const int32_t* actions, uint32_t* rewards, uint8_t* dones, size_t n, bool auto_reset) {
+    //applies actions[i] to boards[i], spawns a tile if the board changed and reports the merge score
+    //and whether the game is over afterwards. a move that does not change the board is a no-op with
+    //reward 0. with auto_reset finished boards are replaced by a fresh game in the same call
+    for_each_chunk(n, [&](size_t begin, size_t end) {
+        uint64_t moved[env_chunk_size];
+        uint32_t scores[env_chunk_size];
+        move_batch(boards + begin, actions + begin, moved, scores, end - begin);
+        for (size_t i = begin; i < end; ++i) {
+            uint64_t board = boards[i];
+            uint32_t reward = 0;
+            bool done = is_game_over(board);
+            if (!done) {
+                const uint64_t new_board = moved[i - begin];
+                if (new_board != board) {
+                    board = add_new_tile(new_board);
+                    reward = scores[i - begin];
+                }
+                done = is_game_over(board);
+            }
+            if (done && auto_reset) board = new_game_board();
+            boards[i] = board;
+            rewards[i] = reward;
+            dones[i] = done;
+        }
+    });
+}
+
+void game_over_mask(const uint64_t* boards, uint8_t* dones, size_t n) {
+    for_each_chunk(n, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) dones[i] = is_game_over(boards[i]);
+    });
+}
+
+void simple_best_moves(const uint64_t* boards, int32_t* actions, size_t n, int policy) {
+    //finished boards get action 0, which step_boards treats as a no-op
+    const auto choose = policy_entry(choose_move_table, policy);
+    for_each_chunk(n, [&](size_t begin, size_t end) {
+        Rng& rng = thread_rng();
+        for (size_t i = begin; i < end; ++i) {
+            const Successors next = successors(boards[i]);
+            actions[i] = next.legal == 0 ? 0 : (int32_t)choose(next, rng);
+        }
+    });
+}
+
+void canonicalize_boards(const uint64_t* boards, uint64_t* out_boards, uint8_t* symmetries, size_t n) {
+    //no randomness, so the chunks do not need rng streams like for_each_chunk
+    const size_t n_chunks = (n + env_chunk_size - 1) / env_chunk_size;
+    get_rollout_pool().parallel_for(n_chunks, [&](size_t chunk) {
+        const size_t end = std::min(n, (chunk + 1) * env_chunk_size);
+        for (size_t i = chunk * env_chunk_size; i < end; ++i) {
+            const CanonicalBoard canonical = canonical_board(boards[i]);
+            out_boards[i] = canonical.board;
+            symmetries[i] = (uint8_t)canonical.symmetry;
+        }
+    });
+}
+
+void transform_boards(const uint64_t* boards, const uint8_t* symmetries, uint64_t* out_boards, size_t n) {
+    const size_t n_chunks = (n + env_chunk_size - 1) / env_chunk_size;
+    get_rollout_pool().parallel_for(n_chunks, [&](size_t chunk) {
+        const size_t end = std::min(n, (chunk + 1) * env_chunk_size);
+        for (size_t i = chunk * env_chunk_size; i < end; ++i) out_boards[i] = apply_symmetry(boards[i], symmetries[i] & 7);
+    });
+}
@@ -0,0 +1,82 @@
+#include "Geometry.h"
+#include <stdexcept>
+
+// Every geometry instantiates its moves, policies, rollouts and expectimax search here, the run time
+// table below only converts the board between the geometry's type and WideBoard
+template <typename G>
+struct GeometryEntry {
+    using Game = GeometryGame<G>;
+    using Board = typename G::Board;
+
+    static WideBoard new_game() {
+        Rng& rng = thread_rng();
+        return Game::spawn(Game::spawn(0, rng), rng);
+    }
+
+    static std::pair<WideBoard, uint64_t> move(WideBoard board, int direction) {
+        if (direction < 0 || direction > 3) return {board, 0}; //like move() of the default board
+        const typename Game::Successors next = Game::successors((Board)board);
+        return {next.boards[direction], next.scores[direction]};
+    }
+
+    static WideBoard add_new_tile(WideBoard board) {
+        return Game::spawn((Board)board, thread_rng());
+    }
+
+    static unsigned legal_moves(WideBoard board) {
+        return Game::successors((Board)board).legal;
+    }
+
+    static std::array<double, 4> scores(WideBoard board, int samples, int depth, int policy) {
+        return geometry_scores<G>((Board)board, samples, depth, policy);
+    }
+
+    static unsigned best_move(WideBoard board, int samples, int depth, int policy) {
+        return geometry_best_move<G>((Board)board, samples, depth, policy);
+    }
+
+    static std::array<double, 4> expectimax_scores(WideBoard board, int depth, double min_probability) {
+        return GeometryExpectimax<Game>::scores((Board)board, depth, min_probability);
+    }
+
+    static unsigned expectimax_move(WideBoard board, int depth, double min_probability) {
+        return geometry_expectimax_move<G>((Board)board, depth, min_probability);
+    }
+
+    static unsigned policy_move(WideBoard board, int policy) {
+        const typename Game::Successors next = Game::successors((Board)board);
+        if (next.legal == 0) return 0; //game over, any move is a no-op
+        return geometry_policy_entry<Game, GeometryChooseMove<Game>>(policy)(next, thread_rng());
+    }
+
+    static uint64_t max_tile(WideBoard board) {
+        unsigned rank = 0;
+        for (int i = 0; i < G::cells; ++i) rank = std::max(rank, Game::cell((Board)board, i));
+        return rank == 0 ? 0 : 1ULL << rank;
+    }
+
+    static GeometryFunctions functions(const char* name) {
+        return {name, G::rows, G::cell_bits, &new_game, &move, &add_new_tile, &legal_moves, &scores, &best_move,
+                &expectimax_scores, &expectimax_move, &policy_move, &max_tile};
+    }
+};
+
+static const GeometryFunctions geometries[] = {
+    GeometryEntry<DefaultGeometry>::functions("4x4x4"),
+    GeometryEntry<Geometry<4, 4, 5>>::functions("4x4x5"),
+    GeometryEntry<Geometry<3, 3, 4>>::functions("3x3x4"),
+    GeometryEntry<Geometry<5, 5, 4>>::functions("5x5x4"),
+};
+
+const GeometryFunctions& geometry_functions(const std::string& name) {
+    for (const GeometryFunctions& geometry : geometries) {
+        if (name == geometry.name) return geometry;
+    }
+    throw std::invalid_argument("unknown geometry " + name + ", expected one of 4x4x4, 4x4x5, 3x3x4, 5x5x4");
+}
+
+std::vector<std::string> geometry_names() {
+    std::vector<std::string> names;
+    for (const GeometryFunctions& geometry : geometries) names.push_back(geometry.name);
+    return names;
+}
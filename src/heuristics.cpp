@@ -0,0 +1,91 @@
+#include "heuristics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Generation of the heuristic row tables, the lookups are inline in heuristics.h
+
+// Weights of the board evaluator
+const double heur_lost_penalty = 200000.0;
+const double heur_empty_weight = 270.0;
+const double heur_merges_weight = 700.0;
+const double heur_monotonicity_power = 4.0;
+const double heur_monotonicity_weight = 47.0;
+const double heur_smoothness_weight = 11.0;
+
+uint8_t heur_empty[65536];           // number of empty cells
+uint8_t heur_merges[65536];          // number of tiles that can merge with a neighbour
+float heur_monotonicity[65536];      // penalty for the row going up and down, lower is more monotonic
+float heur_smoothness[65536];        // summed rank difference of neighbouring tiles, lower is smoother
+float heur_score[65536];             // weighted sum of the features above, what evaluate_board adds up
+uint16_t heur_min_diff[65536];       // per cell the smaller rank difference to its left/right neighbour
+
+RowFeatures row_features(const int* rank, int n) {
+    int empty = 0;
+    int merges = 0;
+    int prev = 0;
+    int counter = 0;
+    for (int i = 0; i < n; ++i) {
+        if (rank[i] == 0) {
+            empty++;
+            continue;
+        }
+        if (prev == rank[i]) {
+            counter++;
+        } else if (counter > 0) {
+            merges += 1 + counter;
+            counter = 0;
+        }
+        prev = rank[i];
+    }
+    if (counter > 0) merges += 1 + counter;
+
+    double monotonicity_left = 0;
+    double monotonicity_right = 0;
+    for (int i = 1; i < n; ++i) {
+        const double a = std::pow(rank[i - 1], heur_monotonicity_power);
+        const double b = std::pow(rank[i], heur_monotonicity_power);
+        if (rank[i - 1] > rank[i]) monotonicity_left += a - b;
+        else monotonicity_right += b - a;
+    }
+    const double monotonicity = std::min(monotonicity_left, monotonicity_right);
+
+    double smoothness = 0;
+    for (int i = 1; i < n; ++i) {
+        if (rank[i - 1] != 0 && rank[i] != 0) smoothness += std::abs(rank[i - 1] - rank[i]);
+    }
+
+    const double score = heur_lost_penalty / n
+                         + heur_empty_weight * empty
+                         + heur_merges_weight * merges
+                         - heur_monotonicity_weight * monotonicity
+                         - heur_smoothness_weight * smoothness;
+    return {empty, merges, monotonicity, smoothness, score};
+}
+
+// Fills the tables, runs once while the library is loaded like the move tables in game.cpp
+static bool fill_heuristic_tables() {
+    for (uint32_t row = 0; row < 65536; ++row) {
+        int rank[4];
+        for (int i = 0; i < 4; ++i) rank[i] = (row >> (i * 4)) & 0xF;
+
+        const RowFeatures features = row_features(rank, 4);
+        heur_empty[row] = (uint8_t)features.empty;
+        heur_merges[row] = (uint8_t)features.merges;
+        heur_monotonicity[row] = (float)features.monotonicity;
+        heur_smoothness[row] = (float)features.smoothness;
+        heur_score[row] = (float)features.score;
+
+        uint16_t min_diff = 0;
+        for (int i = 0; i < 4; ++i) {
+            int diff = 16;
+            if (i > 0) diff = std::min(diff, std::abs(rank[i] - rank[i - 1]));
+            if (i < 3) diff = std::min(diff, std::abs(rank[i] - rank[i + 1]));
+            min_diff |= (uint16_t)(diff << (i * 4));
+        }
+        heur_min_diff[row] = min_diff;
+    }
+    return true;
+}
+
+static const bool heuristic_tables_filled = fill_heuristic_tables();
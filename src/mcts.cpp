@@ -0,0 +1,246 @@
+#include "MCTS.h"
+#include "game.h"
+#include "tables.h"
+#include "policies.h"
+#include "Stats.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+
+MCTS::MCTS(size_t capacity, double exploration, int rollout_depth, int policy)
+    : max_nodes(capacity < 2 ? 2 : capacity), exploration(exploration), rollout_depth(rollout_depth), policy(policy) {
+    nodes.reserve(max_nodes);
+    spare.reserve(max_nodes);
+}
+
+void MCTS::reset() {
+    nodes.clear();
+    root = NONE;
+}
+
+uint32_t MCTS::allocate(uint64_t board) {
+    if (nodes.size() >= max_nodes) return NONE;
+    nodes.push_back({board, 0.0, 0, NONE, NONE, 0, 0, false});
+    return (uint32_t)(nodes.size() - 1);
+}
+
+void MCTS::set_root(uint64_t board) {
+    //tree reuse: the new board is one of the spawn outcomes below the current root
+    if (root != NONE) {
+        if (nodes[root].board == board) return;
+        uint32_t found = NONE;
+        for (uint32_t c = nodes[root].first_child; c != NONE && found == NONE; c = nodes[c].next_sibling) {
+            for (uint32_t d = nodes[c].first_child; d != NONE; d = nodes[d].next_sibling) {
+                if (nodes[d].board == board) {
+                    found = d;
+                    break;
+                }
+            }
+        }
+        if (found != NONE) {
+            //breadth first copy of the subtree into the spare arena, the links are rewritten on the way
+            spare.clear();
+            std::deque<std::pair<uint32_t, uint32_t>> queue; //(old index, new index)
+            spare.push_back(nodes[found]);
+            spare[0].next_sibling = NONE;
+            queue.push_back({found, 0});
+            while (!queue.empty()) {
+                auto [old_index, new_index] = queue.front();
+                queue.pop_front();
+                uint32_t previous = NONE;
+                for (uint32_t c = nodes[old_index].first_child; c != NONE; c = nodes[c].next_sibling) {
+                    const uint32_t copy = (uint32_t)spare.size();
+                    spare.push_back(nodes[c]);
+                    spare[copy].next_sibling = NONE;
+                    if (previous == NONE) spare[new_index].first_child = copy;
+                    else spare[previous].next_sibling = copy;
+                    previous = copy;
+                    queue.push_back({c, copy});
+                }
+            }
+            nodes.swap(spare);
+            root = 0;
+            return;
+        }
+    }
+    reset();
+    root = allocate(board);
+}
+
+uint32_t MCTS::select_move(uint32_t node) const {
+    //UCT. the values are game scores, so the exploration term is scaled by the mean value of the parent
+    const Node& parent = nodes[node];
+    const double scale = parent.visits > 0 ? std::max(1.0, parent.value_sum / parent.visits) : 1.0;
+    const double log_visits = std::log((double)std::max(1u, parent.visits));
+    uint32_t best = NONE;
+    double best_score = 0;
+    for (uint32_t c = parent.first_child; c != NONE; c = nodes[c].next_sibling) {
+        const Node& child = nodes[c];
+        if (child.visits == 0) return c;
+        const double score = child.value_sum / child.visits + exploration * scale * std::sqrt(log_visits / child.visits);
+        if (best == NONE || score > best_score) {
+            best_score = score;
+            best = c;
+        }
+    }
+    return best;
+}
+
+struct PlayOut {
+    template <typename Policy>
+    static double run(uint64_t board, int depth, Rng& rng) {
+        return play_out<Policy>(board, depth, rng);
+    }
+};
+
+static const auto play_out_table = make_policy_table<PlayOut>();
+
+double MCTS::rollout(uint64_t board) const {
+    return policy_entry(play_out_table, policy)(board, rollout_depth, thread_rng());
+}
+
+void MCTS::iterate() {
+    //path of visited nodes, with the reward collected before entering each of them
+    uint32_t path[1024];
+    double reward_before[1024];
+    int length = 0;
+    double reward = 0;
+    double leaf_value = 0;
+
+    uint32_t node = root;
+    while (length < 1022) {
+        //decision node
+        path[length] = node;
+        reward_before[length++] = reward;
+        if (!nodes[node].expanded) {
+            const uint64_t board = nodes[node].board;
+            const bool was_visited = nodes[node].visits > 0 || node == root;
+            if (!was_visited) {
+                leaf_value = rollout(board);
+                break;
+            }
+            //expand on the second visit: one chance node per possible move
+            const Successors next = successors(board);
+            const size_t mark = nodes.size();
+            uint32_t previous = NONE;
+            bool complete = true;
+            for (int direction = 0; direction < 4; ++direction) {
+                if (!(next.legal & (1u << direction))) continue;
+                const uint32_t c = allocate(next.boards[direction]);
+                if (c == NONE) {
+                    complete = false;
+                    break;
+                }
+                nodes[c].reward = next.scores[direction];
+                nodes[c].move = (uint8_t)direction;
+                if (previous == NONE) nodes[node].first_child = c;
+                else nodes[previous].next_sibling = c;
+                previous = c;
+            }
+            if (!complete) {
+                //arena is full, the partial expansion is dropped and its nodes freed, the node stays a leaf
+                nodes.resize(mark);
+                nodes[node].first_child = NONE;
+                leaf_value = rollout(board);
+                break;
+            }
+            nodes[node].expanded = true;
+        }
+        if (nodes[node].first_child == NONE) break; //game over
+
+        //chance node
+        const uint32_t chance = select_move(node);
+        path[length] = chance;
+        reward_before[length++] = reward;
+        reward += nodes[chance].reward;
+
+        const uint64_t spawned = add_new_tile(nodes[chance].board);
+        uint32_t next = NONE;
+        uint32_t last = NONE;
+        for (uint32_t d = nodes[chance].first_child; d != NONE; d = nodes[d].next_sibling) {
+            last = d;
+            if (nodes[d].board == spawned) {
+                next = d;
+                break;
+            }
+        }
+        if (next == NONE) {
+            next = allocate(spawned);
+            if (next == NONE) {
+                leaf_value = rollout(spawned);
+                break;
+            }
+            if (last == NONE) nodes[chance].first_child = next;
+            else nodes[last].next_sibling = next;
+        }
+        node = next;
+    }
+
+    //the return of every node is everything collected after entering it
+    const double total = reward + leaf_value;
+    for (int i = 0; i < length; ++i) {
+        nodes[path[i]].visits++;
+        nodes[path[i]].value_sum += total - reward_before[i];
+    }
+}
+
+unsigned MCTS::search(uint64_t board, int iterations) {
+    SearchLatency latency(STAT_SEARCH_MCTS);
+    set_root(board);
+    for (int i = 0; i < iterations; ++i) iterate();
+    STAT_ADD(STAT_MCTS_ITERATIONS, std::max(0, iterations));
+    return most_visited_move();
+}
+
+MCTS::TimedResult MCTS::search_for(uint64_t board, int64_t budget_us) {
+    const auto start = std::chrono::steady_clock::now();
+    const auto deadline = start + std::chrono::microseconds(std::max<int64_t>(0, budget_us));
+    SearchLatency latency(STAT_SEARCH_MCTS);
+    set_root(board);
+    uint64_t iterations = 0;
+    while (std::chrono::steady_clock::now() < deadline) {
+        iterate();
+        iterations++;
+    }
+    STAT_ADD(STAT_MCTS_ITERATIONS, iterations);
+    const double elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    return {most_visited_move(), iterations, elapsed_us};
+}
+
+unsigned MCTS::most_visited_move() const {
+    unsigned best_move = 0;
+    uint32_t best_visits = 0;
+    bool found = false;
+    for (uint32_t c = nodes[root].first_child; c != NONE; c = nodes[c].next_sibling) {
+        if (!found || nodes[c].visits > best_visits) {
+            best_visits = nodes[c].visits;
+            best_move = nodes[c].move;
+            found = true;
+        }
+    }
+    if (!found) {
+        //the root was not expanded within the budget, any possible move
+        const unsigned legal = successors(nodes[root].board).legal;
+        if (legal != 0) best_move = first_move(legal);
+    }
+    return best_move;
+}
+
+std::vector<unsigned> MCTS::root_visits() const {
+    std::vector<unsigned> visits(4, 0);
+    if (root == NONE) return visits;
+    for (uint32_t c = nodes[root].first_child; c != NONE; c = nodes[c].next_sibling) {
+        visits[nodes[c].move] = nodes[c].visits;
+    }
+    return visits;
+}
+
+std::vector<double> MCTS::root_values() const {
+    std::vector<double> values(4, 0.0);
+    if (root == NONE) return values;
+    for (uint32_t c = nodes[root].first_child; c != NONE; c = nodes[c].next_sibling) {
+        if (nodes[c].visits > 0) values[nodes[c].move] = nodes[c].value_sum / nodes[c].visits;
+    }
+    return values;
+}
@@ -0,0 +1,182 @@
+#include "game.h"
+#include "tables.h"
+#include <cstdint>
+#include <cstddef>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define MOVE_BATCH_AVX2
+#include <immintrin.h>
+#endif
+
+// Batched move kernel. applies a direction to many boards at once, the direction can differ per board.
+// up/down transpose the board and reuse the row tables, so every direction costs the same.
+// the AVX2 version handles 4 boards per register, one gather per pair of rows reads the moved row and its
+// score together. the kernel is picked at runtime
+
+static void move_batch_scalar(const uint64_t* boards, const int32_t* directions, uint64_t* out_boards, uint32_t* out_scores, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t board = boards[i];
+        const int32_t direction = directions[i];
+        if (direction < 0 || direction > 3) {
+            out_boards[i] = board;
+            out_scores[i] = 0;
+            continue;
+        }
+        const bool columns = direction >= 2;
+        const bool right = direction & 1;
+        unsigned score;
+        uint64_t b = columns ? transpose(board) : board;
+        b = move_rows(b, right ? move_table_right : move_table_left, score);
+        out_boards[i] = columns ? transpose(b) : b;
+        out_scores[i] = score;
+    }
+}
+
+#ifdef MOVE_BATCH_AVX2
+
+__attribute__((target("avx2")))
+static inline __m256i transpose_avx2(__m256i x) {
+    const __m256i a1 = _mm256_and_si256(x, _mm256_set1_epi64x((long long)0xF0F00F0FF0F00F0FULL));
+    const __m256i a2 = _mm256_and_si256(x, _mm256_set1_epi64x((long long)0x0000F0F00000F0F0ULL));
+    const __m256i a3 = _mm256_and_si256(x, _mm256_set1_epi64x((long long)0x0F0F00000F0F0000ULL));
+    const __m256i a = _mm256_or_si256(a1, _mm256_or_si256(_mm256_slli_epi64(a2, 12), _mm256_srli_epi64(a3, 12)));
+    const __m256i b1 = _mm256_and_si256(a, _mm256_set1_epi64x((long long)0xFF00FF0000FF00FFULL));
+    const __m256i b2 = _mm256_and_si256(a, _mm256_set1_epi64x((long long)0x00FF00FF00000000ULL));
+    const __m256i b3 = _mm256_and_si256(a, _mm256_set1_epi64x((long long)0x00000000FF00FF00ULL));
+    return _mm256_or_si256(b1, _mm256_or_si256(_mm256_srli_epi64(b2, 24), _mm256_slli_epi64(b3, 24)));
+}
+
+__attribute__((target("avx2")))
+static void move_batch_avx2(const uint64_t* boards, const int32_t* directions, uint64_t* out_boards, uint32_t* out_scores, size_t n) {
+    const __m256i row_mask = _mm256_set1_epi64x(0x0000FFFF0000FFFFLL);
+    const __m256i low16 = _mm256_set1_epi32(0xFFFF);
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i three = _mm256_set1_epi64x(3);
+    const int* table_left = reinterpret_cast<const int*>(move_table_left);
+    const int* table_right = reinterpret_cast<const int*>(move_table_right);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m256i board = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(boards + i));
+        const __m256i dir = _mm256_cvtepi32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(directions + i)));
+
+        //per 64 bit lane masks: column move, right table, valid direction
+        const __m256i columns = _mm256_cmpgt_epi64(dir, one);
+        const __m256i right = _mm256_cmpeq_epi64(_mm256_and_si256(dir, one), one);
+        const __m256i valid = _mm256_andnot_si256(_mm256_or_si256(_mm256_cmpgt_epi64(_mm256_setzero_si256(), dir),
+                                                                  _mm256_cmpgt_epi64(dir, three)),
+                                                  _mm256_set1_epi64x(-1));
+        const __m256i left = _mm256_andnot_si256(right, _mm256_set1_epi64x(-1));
+
+        const __m256i b = _mm256_blendv_epi8(board, transpose_avx2(board), columns);
+
+        //rows 0 and 2 of every board in the 32 bit lanes of lo, rows 1 and 3 in hi
+        const __m256i lo = _mm256_and_si256(b, row_mask);
+        const __m256i hi = _mm256_and_si256(_mm256_srli_epi64(b, 16), row_mask);
+
+        __m256i entry_lo = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), table_left, lo, left, 4);
+        entry_lo = _mm256_mask_i32gather_epi32(entry_lo, table_right, lo, right, 4);
+        __m256i entry_hi = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), table_left, hi, left, 4);
+        entry_hi = _mm256_mask_i32gather_epi32(entry_hi, table_right, hi, right, 4);
+
+        //the low 16 bits of an entry are the moved row, the high 16 bits the score / 4
+        __m256i moved = _mm256_or_si256(_mm256_and_si256(entry_lo, low16), _mm256_slli_epi64(_mm256_and_si256(entry_hi, low16), 16));
+        moved = _mm256_blendv_epi8(moved, transpose_avx2(moved), columns);
+        moved = _mm256_blendv_epi8(board, moved, valid);
+
+        __m256i score = _mm256_add_epi32(_mm256_srli_epi32(entry_lo, 16), _mm256_srli_epi32(entry_hi, 16));
+        score = _mm256_add_epi32(score, _mm256_srli_epi64(score, 32));
+        score = _mm256_and_si256(_mm256_slli_epi32(score, 2), valid);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_boards + i), moved);
+        //pack the low 32 bits of every 64 bit lane
+        const __m256i packed = _mm256_permutevar8x32_epi32(score, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out_scores + i), _mm256_castsi256_si128(packed));
+    }
+    move_batch_scalar(boards + i, directions + i, out_boards + i, out_scores + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void move_batch_dir_avx2(const uint64_t* boards, int direction, uint64_t* out_boards, uint32_t* out_scores, size_t n) {
+    //same direction for every board: one unmasked gather per row pair
+    const bool columns = direction >= 2;
+    const int* table = reinterpret_cast<const int*>((direction & 1) ? move_table_right : move_table_left);
+    const __m256i row_mask = _mm256_set1_epi64x(0x0000FFFF0000FFFFLL);
+    const __m256i low16 = _mm256_set1_epi32(0xFFFF);
+
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(boards + i));
+        if (columns) b = transpose_avx2(b);
+
+        const __m256i lo = _mm256_and_si256(b, row_mask);
+        const __m256i hi = _mm256_and_si256(_mm256_srli_epi64(b, 16), row_mask);
+        const __m256i entry_lo = _mm256_i32gather_epi32(table, lo, 4);
+        const __m256i entry_hi = _mm256_i32gather_epi32(table, hi, 4);
+
+        __m256i moved = _mm256_or_si256(_mm256_and_si256(entry_lo, low16), _mm256_slli_epi64(_mm256_and_si256(entry_hi, low16), 16));
+        if (columns) moved = transpose_avx2(moved);
+
+        __m256i score = _mm256_add_epi32(_mm256_srli_epi32(entry_lo, 16), _mm256_srli_epi32(entry_hi, 16));
+        score = _mm256_slli_epi32(_mm256_add_epi32(score, _mm256_srli_epi64(score, 32)), 2);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out_boards + i), moved);
+        const __m256i packed = _mm256_permutevar8x32_epi32(score, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out_scores + i), _mm256_castsi256_si128(packed));
+    }
+    const int32_t directions[4] = {direction, direction, direction, direction};
+    for (; i < n; ++i) move_batch_scalar(boards + i, directions, out_boards + i, out_scores + i, 1);
+}
+
+#endif
+
+using move_batch_kernel = void (*)(const uint64_t*, const int32_t*, uint64_t*, uint32_t*, size_t);
+
+using move_batch_dir_kernel = void (*)(const uint64_t*, int, uint64_t*, uint32_t*, size_t);
+
+static void move_batch_dir_scalar(const uint64_t* boards, int direction, uint64_t* out_boards, uint32_t* out_scores, size_t n) {
+    int32_t directions[256];
+    for (int k = 0; k < 256; ++k) directions[k] = direction;
+    for (size_t i = 0; i < n; i += 256) {
+        const size_t count = (n - i < 256) ? n - i : 256;
+        move_batch_scalar(boards + i, directions, out_boards + i, out_scores + i, count);
+    }
+}
+
+static bool cpu_has_avx2() {
+#ifdef MOVE_BATCH_AVX2
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+static const bool use_avx2 = cpu_has_avx2();
+
+#ifdef MOVE_BATCH_AVX2
+static const move_batch_kernel move_batch_impl = use_avx2 ? move_batch_avx2 : move_batch_scalar;
+static const move_batch_dir_kernel move_batch_dir_impl = use_avx2 ? move_batch_dir_avx2 : move_batch_dir_scalar;
+#else
+static const move_batch_kernel move_batch_impl = move_batch_scalar;
+static const move_batch_dir_kernel move_batch_dir_impl = move_batch_dir_scalar;
+#endif
+
+void move_batch(const uint64_t* boards, const int32_t* directions, uint64_t* out_boards, uint32_t* out_scores, size_t n) {
+    move_batch_impl(boards, directions, out_boards, out_scores, n);
+}
+
+void move_batch(const uint64_t* boards, int direction, uint64_t* out_boards, uint32_t* out_scores, size_t n) {
+    if (direction < 0 || direction > 3) {
+        for (size_t i = 0; i < n; ++i) {
+            out_boards[i] = boards[i];
+            out_scores[i] = 0;
+        }
+        return;
+    }
+    move_batch_dir_impl(boards, direction, out_boards, out_scores, n);
+}
+
+const char* move_batch_kernel_name() {
+    return use_avx2 ? "avx2" : "scalar";
+}
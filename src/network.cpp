@@ -0,0 +1,343 @@
+#include "Network.h"
+#include "game.h"
+#include "ThreadPool.h"
+#include "tables.h"
+#include "policies.h"
+#include "Random.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define NETWORK_AVX2
+#include <immintrin.h>
+#endif
+
+static const char network_magic[8] = {'M', '2', '0', '4', '8', 'M', 'L', 'P'};
+static const uint32_t network_version = 1;
+
+Network::Network(const std::string& path) {
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(path.c_str(), "rb"), &std::fclose);
+    if (!file) throw std::runtime_error("cannot open " + path);
+    auto read = [&](void* data, size_t size) {
+        if (std::fread(data, 1, size, file.get()) != size) throw std::runtime_error(path + " is truncated");
+    };
+
+    char magic[8];
+    uint32_t version, n_layers;
+    read(magic, sizeof(magic));
+    if (std::memcmp(magic, network_magic, sizeof(magic)) != 0) throw std::runtime_error(path + " is not a network file");
+    read(&version, sizeof(version));
+    if (version != network_version) throw std::runtime_error(path + " has an unsupported network file version");
+    read(&n_layers, sizeof(n_layers));
+    if (n_layers == 0 || n_layers > 64) throw std::runtime_error(path + " has an invalid number of layers");
+    std::vector<uint32_t> widths(n_layers + 1);
+    read(widths.data(), widths.size() * sizeof(uint32_t));
+    for (uint32_t width : widths) {
+        if (width == 0 || width > 65536) throw std::runtime_error(path + " has an invalid layer width");
+    }
+
+    for (uint32_t l = 0; l < n_layers; ++l) {
+        Layer layer;
+        layer.in = widths[l];
+        layer.out = widths[l + 1];
+        layer.out_padded = (layer.out + 7) / 8 * 8;
+        std::vector<float> weights(layer.out * layer.in);
+        read(weights.data(), weights.size() * sizeof(float));
+        layer.weights.assign(layer.in * layer.out_padded, 0.0f);
+        for (size_t o = 0; o < layer.out; ++o) {
+            for (size_t i = 0; i < layer.in; ++i) layer.weights[i * layer.out_padded + o] = weights[o * layer.in + i];
+        }
+        layer.bias.assign(layer.out_padded, 0.0f);
+        read(layer.bias.data(), layer.out * sizeof(float));
+        max_width = std::max({max_width, layer.in, layer.out_padded});
+        layers.push_back(std::move(layer));
+    }
+}
+
+// Samples that go through a layer together: every weight that is loaded is used for all of them
+const size_t forward_block = 4;
+
+// y[s] = x[s] W + b for Rows samples, y[s] at y + s * y_stride, and SiLU unless it is the last layer
+template <size_t Rows>
+static void layer_scalar(const float* const* x, float* y, size_t y_stride, size_t in, size_t out_padded,
+                         const float* weights, const float* bias, bool activation) {
+    for (size_t s = 0; s < Rows; ++s) {
+        for (size_t o = 0; o < out_padded; ++o) y[s * y_stride + o] = bias[o];
+    }
+    for (size_t i = 0; i < in; ++i) {
+        const float* w = weights + i * out_padded;
+        for (size_t s = 0; s < Rows; ++s) {
+            const float xi = x[s][i];
+            float* ys = y + s * y_stride;
+            for (size_t o = 0; o < out_padded; ++o) ys[o] += xi * w[o];
+        }
+    }
+    if (activation) {
+        for (size_t s = 0; s < Rows; ++s) {
+            float* ys = y + s * y_stride;
+            for (size_t o = 0; o < out_padded; ++o) ys[o] = ys[o] / (1.0f + std::exp(-ys[o]));
+        }
+    }
+}
+
+#ifdef NETWORK_AVX2
+
+// exp for 8 floats, range reduction to 2^n * e^r and a degree 5 polynomial for e^r (cephes expf)
+__attribute__((target("avx2,fma")))
+static inline __m256 exp_avx2(__m256 x) {
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-87.0f)), _mm256_set1_ps(88.0f));
+    const __m256 n = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)),
+                                     _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+    r = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), r);
+    __m256 p = _mm256_set1_ps(1.9875691500e-4f);
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+    p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+    p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), _mm256_add_ps(r, _mm256_set1_ps(1.0f)));
+    const __m256i exponent = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(exponent));
+}
+
+__attribute__((target("avx2,fma")))
+static inline __m256 silu_avx2(__m256 x) {
+    const __m256 e = exp_avx2(_mm256_sub_ps(_mm256_setzero_ps(), x));
+    return _mm256_div_ps(x, _mm256_add_ps(_mm256_set1_ps(1.0f), e));
+}
+
+template <size_t Rows>
+__attribute__((target("avx2,fma")))
+static void layer_avx2(const float* const* x, float* y, size_t y_stride, size_t in, size_t out_padded,
+                       const float* weights, const float* bias, bool activation) {
+    //Vectors * 8 outputs of every sample at a time: the weight loads of an input are shared by the samples,
+    //a single sample gets 4 independent accumulators instead
+    constexpr size_t Vectors = Rows == 1 ? 4 : 2;
+    size_t o = 0;
+    for (; o + Vectors * 8 <= out_padded; o += Vectors * 8) {
+        __m256 acc[Rows][Vectors];
+        for (size_t s = 0; s < Rows; ++s) {
+            for (size_t v = 0; v < Vectors; ++v) acc[s][v] = _mm256_loadu_ps(bias + o + v * 8);
+        }
+        for (size_t i = 0; i < in; ++i) {
+            const float* w = weights + i * out_padded + o;
+            __m256 wv[Vectors];
+            for (size_t v = 0; v < Vectors; ++v) wv[v] = _mm256_loadu_ps(w + v * 8);
+            for (size_t s = 0; s < Rows; ++s) {
+                const __m256 xi = _mm256_set1_ps(x[s][i]);
+                for (size_t v = 0; v < Vectors; ++v) acc[s][v] = _mm256_fmadd_ps(xi, wv[v], acc[s][v]);
+            }
+        }
+        for (size_t s = 0; s < Rows; ++s) {
+            for (size_t v = 0; v < Vectors; ++v) {
+                if (activation) acc[s][v] = silu_avx2(acc[s][v]);
+                _mm256_storeu_ps(y + s * y_stride + o + v * 8, acc[s][v]);
+            }
+        }
+    }
+    //the rest 8 at a time
+    for (; o < out_padded; o += 8) {
+        __m256 acc[Rows];
+        for (size_t s = 0; s < Rows; ++s) acc[s] = _mm256_loadu_ps(bias + o);
+        for (size_t i = 0; i < in; ++i) {
+            const __m256 w = _mm256_loadu_ps(weights + i * out_padded + o);
+            for (size_t s = 0; s < Rows; ++s) acc[s] = _mm256_fmadd_ps(_mm256_set1_ps(x[s][i]), w, acc[s]);
+        }
+        for (size_t s = 0; s < Rows; ++s) {
+            if (activation) acc[s] = silu_avx2(acc[s]);
+            _mm256_storeu_ps(y + s * y_stride + o, acc[s]);
+        }
+    }
+}
+
+static const bool use_avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+
+#else
+
+static const bool use_avx2 = false;
+
+#endif
+
+using layer_kernel = void (*)(const float* const*, float*, size_t, size_t, size_t, const float*, const float*, bool);
+
+// The kernels for blocks of 1 to forward_block samples
+static const layer_kernel scalar_kernels[forward_block] = {layer_scalar<1>, layer_scalar<2>, layer_scalar<3>, layer_scalar<4>};
+#ifdef NETWORK_AVX2
+static const layer_kernel avx2_kernels[forward_block] = {layer_avx2<1>, layer_avx2<2>, layer_avx2<3>, layer_avx2<4>};
+#endif
+
+void Network::forward(const float* inputs, float* outputs, size_t n) const {
+    const layer_kernel* kernels = scalar_kernels;
+#ifdef NETWORK_AVX2
+    if (use_avx2) kernels = avx2_kernels;
+#endif
+    //two activation buffers of forward_block rows of max_width
+    thread_local std::vector<float> buffer;
+    if (buffer.size() < 2 * forward_block * max_width) buffer.resize(2 * forward_block * max_width);
+
+    const size_t n_in = input_size();
+    const size_t n_out = output_size();
+    for (size_t first = 0; first < n; first += forward_block) {
+        const size_t count = std::min(forward_block, n - first);
+        const layer_kernel kernel = kernels[count - 1];
+        float* a = buffer.data();
+        float* b = buffer.data() + forward_block * max_width;
+        const float* x[forward_block];
+        for (size_t s = 0; s < count; ++s) x[s] = inputs + (first + s) * n_in;
+        for (size_t l = 0; l < layers.size(); ++l) {
+            const Layer& layer = layers[l];
+            kernel(x, a, max_width, layer.in, layer.out_padded, layer.weights.data(), layer.bias.data(), l + 1 < layers.size());
+            for (size_t s = 0; s < count; ++s) x[s] = a + s * max_width;
+            std::swap(a, b);
+        }
+        for (size_t s = 0; s < count; ++s) std::memcpy(outputs + (first + s) * n_out, x[s], n_out * sizeof(float));
+    }
+}
+
+const char* network_kernel_name() {
+    return use_avx2 ? "avx2" : "scalar";
+}
+
+static std::unique_ptr<Network> loaded_policy_network;
+static std::unique_ptr<Network> loaded_value_network;
+
+void load_policy_network(const std::string& path) {
+    auto network = std::make_unique<Network>(path);
+    if (network->input_size() != 56 || network->output_size() != 4) {
+        throw std::runtime_error(path + ": a policy network needs 56 inputs and 4 outputs");
+    }
+    loaded_policy_network = std::move(network);
+}
+
+void load_value_network(const std::string& path) {
+    auto network = std::make_unique<Network>(path);
+    if (network->input_size() != 56 || network->output_size() != 1) {
+        throw std::runtime_error(path + ": a value network needs 56 inputs and 1 output");
+    }
+    loaded_value_network = std::move(network);
+}
+
+void clear_networks() {
+    loaded_policy_network.reset();
+    loaded_value_network.reset();
+}
+
+const Network* policy_network() {
+    return loaded_policy_network.get();
+}
+
+const Network* value_network() {
+    return loaded_value_network.get();
+}
+
+// Batched use of the networks. the boards of a chunk go through the network together, so the features
+// and the forward passes run in tight loops instead of once per move of every board
+
+const size_t network_chunk_size = 256;
+
+void network_best_moves(const uint64_t* boards, int32_t* actions, size_t n) {
+    const Network* network = policy_network();
+    if (!network) throw std::runtime_error("no policy network loaded");
+    const size_t n_chunks = (n + network_chunk_size - 1) / network_chunk_size;
+    get_rollout_pool().parallel_for(n_chunks, [&](size_t chunk) {
+        const size_t begin = chunk * network_chunk_size;
+        const size_t count = std::min(n, begin + network_chunk_size) - begin;
+        std::vector<float> features(count * 56);
+        std::vector<float> outputs(count * 4);
+        for (size_t i = 0; i < count; ++i) board_features(boards[begin + i], features.data() + i * 56);
+        network->forward(features.data(), outputs.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            //finished boards get action 0, like simple_best_moves
+            const unsigned legal = successors(boards[begin + i]).legal;
+            actions[begin + i] = legal == 0 ? 0 : (int32_t)NetworkPolicy::best_network_move(outputs.data() + i * 4, legal);
+        }
+    });
+}
+
+vector<double> compute_network_scores(const uint64_t board, const int samples, const int depth) {
+    //rollouts with the policy network, like compute_scores. all samples of all moves are lanes that advance
+    //in lockstep, a chunk of lanes shares one batched forward pass per step. after depth moves a lane that
+    //is still alive gets the value network's score of its board on top, if a value network is loaded
+    const Network* policy = policy_network();
+    const Network* value = value_network();
+    if (!policy) throw std::runtime_error("no policy network loaded");
+
+    const Successors root = successors(board);
+    vector<unsigned> moves;
+    for (unsigned direction = 0; direction < 4; ++direction) {
+        if (root.legal & (1u << direction)) moves.push_back(direction);
+    }
+    vector<double> scores(4, 0.0);
+    if (moves.empty() || samples <= 0) return scores;
+
+    const size_t n_lanes = moves.size() * (size_t)samples;
+    const size_t n_chunks = (n_lanes + network_chunk_size - 1) / network_chunk_size;
+    const uint64_t call_seed = thread_rng().next64();
+    vector<double> partial(n_chunks * 4, 0.0);
+    get_rollout_pool().parallel_for(n_chunks, [&](size_t chunk) {
+        seed_thread_rng(call_seed, chunk);
+        Rng& rng = thread_rng();
+        const size_t begin = chunk * network_chunk_size;
+        const size_t count = std::min(n_lanes, begin + network_chunk_size) - begin;
+
+        uint64_t boards[network_chunk_size];
+        double sums[network_chunk_size];
+        unsigned root_move[network_chunk_size];
+        uint32_t active[network_chunk_size];
+        Successors next[network_chunk_size];
+        float features[network_chunk_size * 56];
+        float outputs[network_chunk_size * 4];
+
+        for (size_t i = 0; i < count; ++i) {
+            root_move[i] = moves[(begin + i) / samples];
+            boards[i] = spawn_tile(root.boards[root_move[i]], rng);
+            sums[i] = root.scores[root_move[i]];
+            active[i] = (uint32_t)i;
+        }
+        size_t n_active = count;
+
+        for (int step = 0; step < depth && n_active > 0; ++step) {
+            //drop the lanes whose game is over, the rest gets its features
+            size_t kept = 0;
+            for (size_t k = 0; k < n_active; ++k) {
+                const uint32_t lane = active[k];
+                next[kept] = successors(boards[lane]);
+                if (next[kept].legal == 0) continue;
+                board_features(boards[lane], features + kept * 56);
+                active[kept++] = lane;
+            }
+            n_active = kept;
+            policy->forward(features, outputs, n_active);
+            for (size_t k = 0; k < n_active; ++k) {
+                const uint32_t lane = active[k];
+                const unsigned direction = NetworkPolicy::best_network_move(outputs + k * 4, next[k].legal);
+                sums[lane] += next[k].scores[direction];
+                boards[lane] = spawn_tile(next[k].boards[direction], rng);
+            }
+        }
+
+        if (value) {
+            size_t kept = 0;
+            for (size_t k = 0; k < n_active; ++k) {
+                const uint32_t lane = active[k];
+                if (successors(boards[lane]).legal == 0) continue; //game over is worth nothing more
+                board_features(boards[lane], features + kept * 56);
+                active[kept++] = lane;
+            }
+            value->forward(features, outputs, kept);
+            for (size_t k = 0; k < kept; ++k) sums[active[k]] += outputs[k];
+        }
+
+        for (size_t i = 0; i < count; ++i) partial[chunk * 4 + root_move[i]] += sums[i];
+    });
+
+    for (size_t chunk = 0; chunk < n_chunks; ++chunk) {
+        for (int direction = 0; direction < 4; ++direction) scores[direction] += partial[chunk * 4 + direction];
+    }
+    return scores;
+}
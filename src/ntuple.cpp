@@ -0,0 +1,215 @@
+#include "NTupleNetwork.h"
+#include "game.h"
+#include "ThreadPool.h"
+#include "tables.h"
+#include "Random.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+static const char ntuple_magic[8] = {'M', '2', '0', '4', '8', 'N', 'T', 'N'};
+static const uint32_t ntuple_version = 1;
+
+// cells are row*4+col: two L-shapes of a row and the two cells below its start, two 2x3 rectangles
+static const std::vector<NTupleNetwork::Tuple> default_tuples = {
+    {0, 1, 2, 3, 4, 5},
+    {4, 5, 6, 7, 8, 9},
+    {0, 1, 2, 4, 5, 6},
+    {4, 5, 6, 8, 9, 10},
+};
+
+NTupleNetwork::NTupleNetwork() : NTupleNetwork(default_tuples) {
+}
+
+NTupleNetwork::NTupleNetwork(const std::vector<Tuple>& tuples) : tuples(tuples), weights(tuples.size() * table_size, 0.0f) {
+    for (const Tuple& tuple : tuples) {
+        for (uint8_t cell : tuple) {
+            if (cell >= 16) throw std::invalid_argument("tuple cells must be in [0, 16)");
+        }
+    }
+}
+
+NTupleNetwork::NTupleNetwork(const std::string& path) {
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(path.c_str(), "rb"), &std::fclose);
+    if (!file) throw std::runtime_error("cannot open " + path);
+    auto read = [&](void* data, size_t size) {
+        if (std::fread(data, 1, size, file.get()) != size) throw std::runtime_error(path + " is truncated");
+    };
+
+    char magic[8];
+    uint32_t version, n_tuples, size;
+    read(magic, sizeof(magic));
+    if (std::memcmp(magic, ntuple_magic, sizeof(magic)) != 0) throw std::runtime_error(path + " is not an n-tuple network file");
+    read(&version, sizeof(version));
+    if (version != ntuple_version) throw std::runtime_error(path + " has an unsupported n-tuple network file version");
+    read(&n_tuples, sizeof(n_tuples));
+    read(&size, sizeof(size));
+    if (size != tuple_size || n_tuples == 0 || n_tuples > 64) throw std::runtime_error(path + " has an unsupported tuple layout");
+    tuples.resize(n_tuples);
+    for (Tuple& tuple : tuples) {
+        read(tuple.data(), tuple_size);
+        for (uint8_t cell : tuple) {
+            if (cell >= 16) throw std::runtime_error(path + " has a tuple cell out of range");
+        }
+    }
+
+    weights.assign(n_tuples * table_size, 0.0f);
+    for (size_t t = 0; t < n_tuples; ++t) {
+        float* w = table(t);
+        size_t filled = 0;
+        while (filled < table_size) {
+            uint32_t run[2];
+            read(run, sizeof(run));
+            if (run[0] > table_size - filled || run[1] > table_size - filled - run[0]) {
+                throw std::runtime_error(path + " has a corrupt weight table");
+            }
+            filled += run[0];
+            read(w + filled, run[1] * sizeof(float));
+            filled += run[1];
+        }
+    }
+}
+
+void NTupleNetwork::save(const std::string& path) const {
+    std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(path.c_str(), "wb"), &std::fclose);
+    if (!file) throw std::runtime_error("cannot open " + path + " for writing");
+    auto write = [&](const void* data, size_t size) {
+        if (std::fwrite(data, 1, size, file.get()) != size) throw std::runtime_error("writing to " + path + " failed");
+    };
+
+    const uint32_t header[3] = {ntuple_version, (uint32_t)tuples.size(), (uint32_t)tuple_size};
+    write(ntuple_magic, sizeof(ntuple_magic));
+    write(header, sizeof(header));
+    for (const Tuple& tuple : tuples) write(tuple.data(), tuple_size);
+
+    for (size_t t = 0; t < tuples.size(); ++t) {
+        const float* w = table(t);
+        size_t i = 0;
+        while (i < table_size) {
+            size_t zeros = 0;
+            while (i + zeros < table_size && w[i + zeros] == 0.0f) ++zeros;
+            size_t count = 0;
+            while (i + zeros + count < table_size && w[i + zeros + count] != 0.0f) ++count;
+            const uint32_t run[2] = {(uint32_t)zeros, (uint32_t)count};
+            write(run, sizeof(run));
+            write(w + i + zeros, count * sizeof(float));
+            i += zeros + count;
+        }
+    }
+    if (std::fflush(file.get()) != 0) throw std::runtime_error("writing to " + path + " failed");
+}
+
+// Table index of a tuple on a board: the exponents of its cells, the first cell in the lowest nibble
+static inline size_t tuple_index(uint64_t board, const NTupleNetwork::Tuple& tuple) {
+    size_t index = 0;
+    for (int k = 0; k < NTupleNetwork::tuple_size; ++k) index |= (size_t)((board >> (tuple[k] * 4)) & 0xF) << (4 * k);
+    return index;
+}
+
+// The training threads share the tables without locks. every weight is read and written with relaxed
+// atomic accesses (std::atomic_ref in C++20), plain loads and stores on x86, so concurrent updates are no
+// data race. an update that lands between another thread's load and store of a weight is lost, which TD
+// learning does not mind
+static inline float load_weight(const float* weight) {
+    float value;
+    __atomic_load(weight, &value, __ATOMIC_RELAXED);
+    return value;
+}
+
+static inline void add_weight(float* weight, float delta) {
+    float value = load_weight(weight) + delta;
+    __atomic_store(weight, &value, __ATOMIC_RELAXED);
+}
+
+float NTupleNetwork::evaluate(uint64_t afterstate) const {
+    uint64_t symmetries[8];
+    board_symmetries(afterstate, symmetries);
+    float value = 0;
+    for (size_t t = 0; t < tuples.size(); ++t) {
+        const float* w = table(t);
+        for (uint64_t board : symmetries) value += load_weight(&w[tuple_index(board, tuples[t])]);
+    }
+    return value;
+}
+
+void NTupleNetwork::update(uint64_t afterstate, float delta) {
+    uint64_t symmetries[8];
+    board_symmetries(afterstate, symmetries);
+    const float step = delta / (float)(tuples.size() * 8);
+    for (size_t t = 0; t < tuples.size(); ++t) {
+        float* w = table(t);
+        for (uint64_t board : symmetries) add_weight(&w[tuple_index(board, tuples[t])], step);
+    }
+}
+
+unsigned NTupleNetwork::best_move(const Successors& next) const {
+    unsigned best_direction = 4;
+    float best_value = 0;
+    for (unsigned direction = 0; direction < 4; ++direction) {
+        if (!(next.legal & (1u << direction))) continue;
+        const float value = next.scores[direction] + evaluate(next.boards[direction]);
+        if (best_direction == 4 || value > best_value) {
+            best_value = value;
+            best_direction = direction;
+        }
+    }
+    return best_direction;
+}
+
+NTupleNetwork::TrainingResult NTupleNetwork::train(uint64_t games, float learning_rate) {
+    //games are handed out one at a time, each with its own rng stream of the call seed
+    std::atomic<uint64_t> next_game(0);
+    std::atomic<uint64_t> total_score(0);
+    std::atomic<uint64_t> max_score(0);
+    trained_games.store(0);
+    const uint64_t call_seed = thread_rng().next64();
+    ThreadPool& pool = get_rollout_pool();
+    pool.parallel_for(pool.size(), [&](size_t) {
+        for (uint64_t game = next_game.fetch_add(1); game < games; game = next_game.fetch_add(1)) {
+            seed_thread_rng(call_seed, game);
+            Rng& rng = thread_rng();
+            uint64_t board = spawn_tile(spawn_tile(0, rng), rng);
+            uint64_t previous = 0;
+            bool has_previous = false;
+            uint64_t score = 0;
+            while (true) {
+                const Successors next = successors(board);
+                if (next.legal == 0) {
+                    //terminal: nothing more to gain after the last afterstate
+                    if (has_previous) update(previous, -learning_rate * evaluate(previous));
+                    break;
+                }
+                const unsigned direction = best_move(next);
+                const uint64_t afterstate = next.boards[direction];
+                const unsigned reward = next.scores[direction];
+                if (has_previous) {
+                    update(previous, learning_rate * (reward + evaluate(afterstate) - evaluate(previous)));
+                }
+                previous = afterstate;
+                has_previous = true;
+                score += reward;
+                board = spawn_tile(afterstate, rng);
+            }
+            total_score.fetch_add(score);
+            uint64_t seen = max_score.load();
+            while (score > seen && !max_score.compare_exchange_weak(seen, score)) {
+            }
+            trained_games.fetch_add(1);
+        }
+    });
+    const uint64_t played = trained_games.load();
+    return {played, played ? (double)total_score.load() / played : 0.0, max_score.load()};
+}
+
+static std::shared_ptr<NTupleNetwork> current_ntuple_network;
+
+void set_ntuple_network(std::shared_ptr<NTupleNetwork> network) {
+    current_ntuple_network = std::move(network);
+    //cached expectimax values were computed with the other leaf value
+    clear_expectimax_table();
+}
+
+const NTupleNetwork* ntuple_network() {
+    return current_ntuple_network.get();
+}
@@ -1,24 +1,486 @@
 #include "game.h"
+#include "MCTS.h"
+#include "DatasetGenerator.h"
+#include "RecordFile.h"
+#include "ReplayBuffer.h"
+#include "Network.h"
+#include "NTupleNetwork.h"
+#include "Random.h"
+#include "Stats.h"
+#include "SearchService.h"
+#include "Geometry.h"
+#include "tables.h"
 #include <pybind11/pybind11.h>
 #include <pybind11/numpy.h>
 #include <pybind11/stl.h>
+#include <cstring>
+#include <stdexcept>
+#include <string>
 
 namespace py = pybind11;
 
+// the batched environment works in place on numpy buffers, so they are not converted: the dtype has to
+// match exactly and the array has to be 1d and contiguous
+template <typename T>
+using inplace_array = py::array_t<T, py::array::c_style>;
+
+template <typename T>
+T* inplace_data(inplace_array<T>& array, const char* name, py::ssize_t n) {
+    if (array.ndim() != 1 || array.size() != n) {
+        throw std::invalid_argument(std::string(name) + " must be a 1d array with one entry per board");
+    }
+    return array.mutable_data();
+}
+
+// Arrays of records.record_dtype are taken by their bytes: any contiguous array of 32 byte items
+static const SelfPlayRecord* record_array(py::array& records, bool writable) {
+    if (records.itemsize() != sizeof(SelfPlayRecord) || !(records.flags() & py::array::c_style)) {
+        throw std::invalid_argument("records must be a contiguous array of records.record_dtype");
+    }
+    if (writable && !records.writeable()) throw std::invalid_argument("out must be writable");
+    return static_cast<const SelfPlayRecord*>(records.data());
+}
+
+// Boards of the wider geometries are python ints of up to 128 bits
+static WideBoard to_wide_board(const py::int_& board) {
+    const uint64_t low = (board & py::int_(~0ULL)).cast<uint64_t>();
+    const uint64_t high = (board >> py::int_(64)).cast<uint64_t>();
+    return ((WideBoard)high << 64) | low;
+}
+
+static py::int_ from_wide_board(WideBoard board) {
+    return py::int_(py::int_((uint64_t)(board >> 64)) << py::int_(64) | py::int_((uint64_t)board));
+}
+
+// Holder deleter of objects whose destructor joins threads that may be waiting for the GIL, in a done
+// callback: python drops the last reference with the GIL held, the destructor runs without it
+template <typename T>
+struct ReleaseGilDelete {
+    void operator()(T* object) const {
+        py::gil_scoped_release release;
+        delete object;
+    }
+};
 
 PYBIND11_MODULE(mcts2048, m) {
     m.doc() = "mcts2048 python bindings";
     //m.def("flood_fill", &flood_fill, "Flood fill algorithm");
     //m.def("distances", &distances, "Distances of all grid cells to a given point. unreachable cells have distance -1");
-    m.def("initialize_tables", &initialize_tables, "Initialize lookup tables");
+    m.def("initialize_tables", &initialize_tables, "No-op, the lookup tables are filled when the module is imported");
     m.def("can_move", &can_move, "Check if a move is possible");
     m.def("move", &cached_move, "Move tiles in a given direction");
     m.def("add_new_tile", &add_new_tile, "Add a new tile to the board");
     m.def("is_game_over", &is_game_over, "Check if the game is over");
     m.def("print_board", &print_board, "Print the board");
     m.def("get_possible_moves", &get_possible_moves, "Get all possible moves");
-    m.def("compute_best_move", &compute_best_move, "Compute the best move");
+    m.def("compute_best_move", &compute_best_move, "Compute the best move", py::call_guard<py::gil_scoped_release>());
     m.def("compute_simple_best_move", &compute_simple_best_move, "Compute the best move using a simple heuristic");
-    m.def("compute_scores", &py_compute_scores, "Compute scores for all possible moves");
+    m.def("compute_scores", &py_compute_scores, "Compute scores for all possible moves", py::call_guard<py::gil_scoped_release>());
+    m.def("compute_adaptive_scores", [](uint64_t board, int samples, int depth, int policy, double z) {
+        AdaptiveScores result;
+        {
+            py::gil_scoped_release release;
+            result = compute_adaptive_scores(board, samples, depth, policy, z);
+        }
+        py::dict scores;
+        scores["best_move"] = result.best_move;
+        scores["rollouts"] = result.rollouts;
+        scores["means"] = result.means;
+        scores["half_widths"] = result.half_widths;
+        scores["counts"] = result.counts;
+        return scores;
+    }, "Rollout scores with adaptive sample allocation: the mean, confidence interval half width and rollout count of every move",
+       py::arg("board"), py::arg("samples") = 1000, py::arg("depth") = 10, py::arg("policy") = 3, py::arg("z") = 2.0);
+    m.def("compute_adaptive_best_move", &compute_adaptive_best_move, "Best move of compute_adaptive_scores",
+          py::arg("board"), py::arg("samples") = 1000, py::arg("depth") = 10, py::arg("policy") = 3, py::arg("z") = 2.0,
+          py::call_guard<py::gil_scoped_release>());
+    m.def("compute_paired_scores", [](uint64_t board, int samples, int depth, int policy) {
+        PairedScores scores;
+        {
+            py::gil_scoped_release release;
+            scores = compute_paired_scores(board, samples, depth, policy);
+        }
+        py::dict result;
+        result["best_move"] = scores.best_move;
+        result["samples"] = scores.samples;
+        result["means"] = scores.means;
+        result["std_errors"] = scores.std_errors;
+        result["differences"] = scores.differences;
+        result["difference_errors"] = scores.difference_errors;
+        return result;
+    }, "Rollout search with common random numbers: mean return and standard error per move, and per pair of moves "
+       "the paired difference differences[a][b] = means[a] - means[b] with its standard error",
+       py::arg("board"), py::arg("samples") = 1000, py::arg("depth") = 10, py::arg("policy") = 3);
+    m.def("compute_paired_best_move", &compute_paired_best_move, "Best move of compute_paired_scores",
+          py::arg("board"), py::arg("samples") = 1000, py::arg("depth") = 10, py::arg("policy") = 3,
+          py::call_guard<py::gil_scoped_release>());
+    m.def("compute_timed_scores", [](uint64_t board, int64_t budget_us, int depth, int policy) {
+        TimedScores result;
+        {
+            py::gil_scoped_release release;
+            result = compute_timed_scores(board, budget_us, depth, policy);
+        }
+        py::dict scores;
+        scores["best_move"] = result.best_move;
+        scores["rollouts"] = result.rollouts;
+        scores["elapsed_us"] = result.elapsed_us;
+        scores["means"] = result.means;
+        scores["counts"] = result.counts;
+        return scores;
+    }, "Rollouts on all workers until budget_us microseconds have passed: the best move, the mean return and rollout count of every move",
+       py::arg("board"), py::arg("budget_us"), py::arg("depth") = 10, py::arg("policy") = 3);
+    m.def("compute_timed_best_move", &compute_timed_best_move, "Best move of compute_timed_scores",
+          py::arg("board"), py::arg("budget_us"), py::arg("depth") = 10, py::arg("policy") = 3,
+          py::call_guard<py::gil_scoped_release>());
+    m.def("compute_expectimax_move", &compute_expectimax_move, "Compute the best move with an expectimax search",
+          py::arg("board"), py::arg("depth") = 4, py::arg("min_probability") = 1e-4, py::call_guard<py::gil_scoped_release>());
+    m.def("compute_expectimax_scores", &compute_expectimax_scores, "Expectimax value of every move, 0 for moves that are not possible",
+          py::arg("board"), py::arg("depth") = 4, py::arg("min_probability") = 1e-4, py::call_guard<py::gil_scoped_release>());
+    m.def("set_expectimax_table_size", &set_expectimax_table_size, "Resize the expectimax transposition table to 2^log2_entries entries");
+    m.def("clear_expectimax_table", &clear_expectimax_table, "Clear the expectimax transposition table");
+    py::class_<MCTS>(m, "MCTS", "UCT tree search with a fixed-size node arena, the tree is kept between moves")
+        .def(py::init<size_t, double, int, int>(), py::arg("capacity") = 1 << 20, py::arg("exploration") = 1.0,
+             py::arg("rollout_depth") = 10, py::arg("policy") = 5)
+        .def("search", &MCTS::search, "Run iterations from board and return the most visited move",
+             py::arg("board"), py::arg("iterations"), py::call_guard<py::gil_scoped_release>())
+        .def("search_for", [](MCTS& tree, uint64_t board, int64_t budget_us) {
+            MCTS::TimedResult result;
+            {
+                py::gil_scoped_release release;
+                result = tree.search_for(board, budget_us);
+            }
+            return py::make_tuple(result.move, result.iterations, result.elapsed_us);
+        }, "Run iterations from board for budget_us microseconds, returns (most visited move, iterations, elapsed_us)",
+           py::arg("board"), py::arg("budget_us"))
+        .def("reset", &MCTS::reset, "Drop the tree")
+        .def("size", &MCTS::size, "Number of nodes in the arena")
+        .def("capacity", &MCTS::capacity, "Maximum number of nodes")
+        .def("root_visits", &MCTS::root_visits, "Visit count of every root move")
+        .def("root_values", &MCTS::root_values, "Mean return of every root move");
+    py::class_<ReplayBuffer, std::shared_ptr<ReplayBuffer>>(m, "ReplayBuffer",
+        "Ring of self-play records in shared memory: producers (threads or processes) push, a trainer samples")
+        .def(py::init<const std::string&, size_t>(), "capacity > 0 creates the segment name, 0 opens an existing one",
+             py::arg("name"), py::arg("capacity") = 0)
+        .def("push", [](ReplayBuffer& buffer, py::array records) {
+            const SelfPlayRecord* in = record_array(records, false);
+            const size_t n = (size_t)records.size();
+            py::gil_scoped_release release;
+            buffer.push(in, n);
+        }, "Append the records, an array of records.record_dtype, overwriting the oldest ones once the ring is full",
+           py::arg("records"))
+        .def("sample", [](const ReplayBuffer& buffer, py::array out) {
+            SelfPlayRecord* records = const_cast<SelfPlayRecord*>(record_array(out, true));
+            const size_t n = (size_t)out.size();
+            py::gil_scoped_release release;
+            return buffer.sample(records, n);
+        }, "Fill out, a writable array of records.record_dtype, with random records of the ring, returns len(out) or 0 while the buffer is empty",
+           py::arg("out"))
+        .def("pushed", &ReplayBuffer::pushed, "Number of records pushed since the segment was created")
+        .def("size", &ReplayBuffer::size, "Number of records in the ring")
+        .def("capacity", &ReplayBuffer::capacity)
+        .def("name", &ReplayBuffer::name)
+        .def("unlink", &ReplayBuffer::unlink, "Remove the name of the segment now instead of when the creating buffer is deleted")
+        .def("__len__", &ReplayBuffer::size);
+    py::class_<DatasetGenerator>(m, "DatasetGenerator", "Self-play data generator, appends (board, scores, move, reward) records to a file")
+        .def(py::init<const std::string&, int, int, int, size_t>(), py::arg("path"), py::arg("samples") = 1000,
+             py::arg("depth") = 10, py::arg("policy") = 3, py::arg("chunk_records") = 4096)
+        .def(py::init<std::shared_ptr<ReplayBuffer>, int, int, int, size_t>(), "Push the records into a replay buffer instead of a file",
+             py::arg("buffer"), py::arg("samples") = 1000, py::arg("depth") = 10, py::arg("policy") = 3, py::arg("chunk_records") = 256)
+        .def("run", &DatasetGenerator::run, "Play until the file holds total_records records or stop() is called, returns the records in the file",
+             py::arg("total_records"), py::call_guard<py::gil_scoped_release>())
+        .def("stop", &DatasetGenerator::stop, "Make a running run() return after the current moves")
+        .def("records", &DatasetGenerator::records, "Number of records in the file")
+        .def("games", &DatasetGenerator::games, "Number of games finished in the current run")
+        .def("path", &DatasetGenerator::path, "Path of the record file");
+    py::class_<Network>(m, "Network", "Dense network from a weight file written by export_network in train.py")
+        .def(py::init<const std::string&>(), py::arg("path"))
+        .def("input_size", &Network::input_size)
+        .def("output_size", &Network::output_size)
+        .def("forward", [](const Network& network, py::array_t<float, py::array::c_style | py::array::forcecast> inputs) {
+            if (inputs.ndim() != 2 || inputs.shape(1) != (py::ssize_t)network.input_size()) {
+                throw std::invalid_argument("inputs must be a (N, input_size) array");
+            }
+            const py::ssize_t n = inputs.shape(0);
+            py::array_t<float> outputs({n, (py::ssize_t)network.output_size()});
+            const float* in = inputs.data();
+            float* out = outputs.mutable_data();
+            {
+                py::gil_scoped_release release;
+                network.forward(in, out, n);
+            }
+            return outputs;
+        }, "Outputs of the network for a batch of inputs", py::arg("inputs"));
+    m.def("load_policy_network", &load_policy_network, "Load the policy network used by policy 7, network_best_moves and compute_network_scores");
+    m.def("load_value_network", &load_value_network, "Load the value network that scores the end of the rollouts of compute_network_scores");
+    m.def("clear_networks", &clear_networks, "Unload the policy and value networks");
+    m.def("network_kernel", &network_kernel_name, "Name of the network kernel picked for this CPU");
+    m.def("network_best_moves", [](inplace_array<uint64_t> boards, inplace_array<int32_t> actions) {
+        const py::ssize_t n = boards.size();
+        const uint64_t* b = inplace_data(boards, "boards", n);
+        int32_t* a = inplace_data(actions, "actions", n);
+        py::gil_scoped_release release;
+        network_best_moves(b, a, n);
+    }, "Write the policy network move of every board to actions", py::arg("boards").noconvert(), py::arg("actions").noconvert());
+    m.def("compute_network_scores", &compute_network_scores, "Scores of all moves from batched rollouts with the policy network, 0 for moves that are not possible",
+          py::arg("board"), py::arg("samples"), py::arg("depth"), py::call_guard<py::gil_scoped_release>());
+    py::class_<NTupleNetwork, std::shared_ptr<NTupleNetwork>>(m, "NTupleNetwork", "N-tuple afterstate value function with a TD(0) self-play trainer")
+        .def(py::init<>(), "Network with the default tuples and all weights 0")
+        .def(py::init<const std::string&>(), py::arg("path"), "Load a weight file")
+        .def("save", &NTupleNetwork::save, py::arg("path"))
+        .def("evaluate", &NTupleNetwork::evaluate, "Value of an afterstate", py::arg("afterstate"))
+        .def("train", [](NTupleNetwork& network, uint64_t games, float learning_rate) {
+            NTupleNetwork::TrainingResult result;
+            {
+                py::gil_scoped_release release;
+                result = network.train(games, learning_rate);
+            }
+            py::dict stats;
+            stats["games"] = result.games;
+            stats["mean_score"] = result.mean_score;
+            stats["max_score"] = result.max_score;
+            return stats;
+        }, "Train on games of self-play on all worker threads, returns the mean and max score of the games",
+           py::arg("games"), py::arg("learning_rate") = 0.1f)
+        .def("games_trained", &NTupleNetwork::games_trained, "Games finished by the running train()");
+    m.def("set_ntuple_network", &set_ntuple_network, "Use an n-tuple network as the expectimax leaf value and for policy 8, None for the table evaluator",
+          py::arg("network"));
+    py::class_<SearchJob, std::shared_ptr<SearchJob>>(m, "SearchJob", "Handle of a search queued on a SearchService")
+        .def("board", &SearchJob::board)
+        .def("status", [](const SearchJob& job) {
+            static const char* const names[] = {"pending", "running", "done", "cancelled"};
+            return names[job.status()];
+        }, "pending, running, done or cancelled")
+        .def("done", &SearchJob::done, "Whether the job finished or was cancelled")
+        .def("cancel", &SearchJob::cancel, "Cancel the job, a running one stops at the next task of its search. returns whether the job ends cancelled")
+        .def("wait", &SearchJob::wait, "Wait for the job, False if timeout_us passed first (negative waits forever)",
+             py::arg("timeout_us") = -1, py::call_guard<py::gil_scoped_release>())
+        .def("result", [](const SearchJob& job) {
+            SearchResult result;
+            {
+                py::gil_scoped_release release;
+                result = job.result();
+            }
+            py::dict out;
+            out["move"] = result.move;
+            out["scores"] = result.scores;
+            out["work"] = result.work;
+            out["elapsed_us"] = result.elapsed_us;
+            return out;
+        }, "Wait for the job and return its move, per move scores, rollouts and time, raises if it was cancelled or failed")
+        .def("add_done_callback", [](std::shared_ptr<SearchJob> job, py::function fn) {
+            //the function is called and dropped on a worker thread, both need the GIL
+            std::shared_ptr<py::function> callback(new py::function(std::move(fn)), [](py::function* f) {
+                py::gil_scoped_acquire acquire;
+                delete f;
+            });
+            job->on_done([job, callback](SearchJob&) {
+                py::gil_scoped_acquire acquire;
+                try {
+                    (*callback)(job);
+                } catch (py::error_already_set& error) {
+                    error.discard_as_unraisable("SearchJob callback");
+                }
+            });
+        }, "Call fn(job) once the job is done or cancelled, on a worker thread (or right away if it is done already)",
+           py::arg("fn"));
+    auto search_config = [](const std::string& search, int samples, int depth, int policy, double z, int64_t budget_us,
+                            double min_probability) {
+        SearchConfig config;
+        config.search = search;
+        config.samples = samples;
+        config.depth = depth;
+        config.policy = policy;
+        config.z = z;
+        config.budget_us = budget_us;
+        config.min_probability = min_probability;
+        return config;
+    };
+    py::class_<SearchService, std::unique_ptr<SearchService, ReleaseGilDelete<SearchService>>>(m, "SearchService",
+        "Worker threads that run searches of many games side by side, one search per thread")
+        .def(py::init<int, uint64_t>(), py::arg("n_threads") = 0, py::arg("seed") = 2048)
+        .def("submit", [search_config](SearchService& service, uint64_t board, const std::string& search, int samples, int depth,
+                                       int policy, double z, int64_t budget_us, double min_probability) {
+            return service.submit(board, search_config(search, samples, depth, policy, z, budget_us, min_probability));
+        }, "Queue a search (mc, adaptive, paired, timed, expectimax or policy) of a board and return its SearchJob",
+           py::arg("board"), py::arg("search") = "mc", py::arg("samples") = 1000, py::arg("depth") = 10, py::arg("policy") = 3,
+           py::arg("z") = 2.0, py::arg("budget_us") = 1000, py::arg("min_probability") = 1e-4)
+        .def("submit_batch", [search_config](SearchService& service, std::vector<uint64_t> boards, const std::string& search,
+                                             int samples, int depth, int policy, double z, int64_t budget_us, double min_probability) {
+            return service.submit_batch(boards, search_config(search, samples, depth, policy, z, budget_us, min_probability));
+        }, "Queue the same search of every board, returns the jobs in order",
+           py::arg("boards"), py::arg("search") = "mc", py::arg("samples") = 1000, py::arg("depth") = 10, py::arg("policy") = 3,
+           py::arg("z") = 2.0, py::arg("budget_us") = 1000, py::arg("min_probability") = 1e-4)
+        .def("pending", &SearchService::pending, "Jobs queued and not taken by a worker yet")
+        .def("size", &SearchService::size, "Number of worker threads")
+        .def("close", &SearchService::shutdown, "Cancel the queued jobs and wait for the running ones",
+             py::call_guard<py::gil_scoped_release>())
+        .def("__enter__", [](SearchService& service) -> SearchService& { return service; }, py::return_value_policy::reference)
+        .def("__exit__", [](SearchService& service, py::args) {
+            py::gil_scoped_release release;
+            service.shutdown();
+        });
+    py::class_<GeometryFunctions, std::unique_ptr<GeometryFunctions, py::nodelete>>(m, "Geometry",
+        "Moves and searches of a board geometry, boards are python ints (see Geometry.h for the layout)")
+        .def_property_readonly("name", [](const GeometryFunctions& g) { return std::string(g.name); })
+        .def_property_readonly("size", [](const GeometryFunctions& g) { return g.size; })
+        .def_property_readonly("cell_bits", [](const GeometryFunctions& g) { return g.cell_bits; })
+        .def("new_game", [](const GeometryFunctions& g) { return from_wide_board(g.new_game()); }, "Empty board with the two starting tiles")
+        .def("move", [](const GeometryFunctions& g, const py::int_& board, int direction) {
+            const auto [next, score] = g.move(to_wide_board(board), direction);
+            return py::make_tuple(from_wide_board(next), score);
+        }, "Board after a move and its merge score, the board itself for a direction other than 0-3", py::arg("board"), py::arg("direction"))
+        .def("add_new_tile", [](const GeometryFunctions& g, const py::int_& board) {
+            return from_wide_board(g.add_new_tile(to_wide_board(board)));
+        }, "Add a 2 or a 4 on a random empty cell", py::arg("board"))
+        .def("get_possible_moves", [](const GeometryFunctions& g, const py::int_& board) {
+            const unsigned legal = g.legal_moves(to_wide_board(board));
+            std::vector<unsigned> moves;
+            for (unsigned direction = 0; direction < 4; ++direction) {
+                if (legal & (1u << direction)) moves.push_back(direction);
+            }
+            return moves;
+        }, py::arg("board"))
+        .def("is_game_over", [](const GeometryFunctions& g, const py::int_& board) { return g.legal_moves(to_wide_board(board)) == 0; },
+             py::arg("board"))
+        .def("compute_scores", [](const GeometryFunctions& g, const py::int_& board, int samples, int depth, int policy) {
+            const WideBoard wide = to_wide_board(board);
+            py::gil_scoped_release release;
+            return g.scores(wide, samples, depth, policy);
+        }, "Sum of the rollout returns of every move, 0 for moves that are not possible. the policies are numbered like compute_scores: "
+           "1 most empty, 2 first move, 3 random and 9 max merge on every geometry, 4x4x4 also has 0 and 4-8",
+           py::arg("board"), py::arg("samples") = 1000, py::arg("depth") = 10, py::arg("policy") = 3)
+        .def("compute_best_move", [](const GeometryFunctions& g, const py::int_& board, int samples, int depth, int policy) {
+            const WideBoard wide = to_wide_board(board);
+            py::gil_scoped_release release;
+            return g.best_move(wide, samples, depth, policy);
+        }, "Best move by compute_scores", py::arg("board"), py::arg("samples") = 1000, py::arg("depth") = 10, py::arg("policy") = 3)
+        .def("compute_expectimax_scores", [](const GeometryFunctions& g, const py::int_& board, int depth, double min_probability) {
+            const WideBoard wide = to_wide_board(board);
+            py::gil_scoped_release release;
+            return g.expectimax_scores(wide, depth, min_probability);
+        }, "Expectimax value of every move, 0 for moves that are not possible",
+           py::arg("board"), py::arg("depth") = 3, py::arg("min_probability") = 1e-4)
+        .def("compute_expectimax_move", [](const GeometryFunctions& g, const py::int_& board, int depth, double min_probability) {
+            const WideBoard wide = to_wide_board(board);
+            py::gil_scoped_release release;
+            return g.expectimax_move(wide, depth, min_probability);
+        }, "Best move by compute_expectimax_scores", py::arg("board"), py::arg("depth") = 3, py::arg("min_probability") = 1e-4)
+        .def("compute_simple_best_move", [](const GeometryFunctions& g, const py::int_& board, int policy) {
+            return g.policy_move(to_wide_board(board), policy);
+        }, "Move of a geometry policy", py::arg("board"), py::arg("policy"))
+        .def("max_tile", [](const GeometryFunctions& g, const py::int_& board) { return g.max_tile(to_wide_board(board)); }, py::arg("board"));
+    m.def("geometry", &geometry_functions, "Geometry by name: 4x4x4 (the default board), 4x4x5 (5 bit cells), 3x3x4 or 5x5x4",
+          py::arg("name"), py::return_value_policy::reference);
+    m.def("geometry_names", &geometry_names, "Names of the geometries the module is built for");
+    m.def("concat_record_files", &concat_record_files, "Write the records of all input files, in order, to one record file",
+          py::arg("output"), py::arg("inputs"), py::call_guard<py::gil_scoped_release>());
+    m.def("set_seed", &set_seed, "Seed the random number generators, for reproducible games and searches");
+    m.def("set_num_threads", &set_num_threads, "Set the number of rollout worker threads (<= 0 uses all cores)");
+    m.def("get_num_threads", &get_num_threads, "Get the number of rollout worker threads");
     m.def("board_to_array", &board_to_array, "Convert board to 2D array");
+    m.def("move_batch", [](py::array_t<uint64_t, py::array::c_style | py::array::forcecast> boards, int direction) {
+        const py::ssize_t n = boards.size();
+        py::array_t<uint64_t> out_boards(n);
+        py::array_t<uint32_t> out_scores(n);
+        const uint64_t* b = boards.data();
+        uint64_t* ob = out_boards.mutable_data();
+        uint32_t* os = out_scores.mutable_data();
+        {
+            py::gil_scoped_release release;
+            move_batch(b, direction, ob, os, n);
+        }
+        return py::make_tuple(out_boards, out_scores);
+    }, "Move all boards of a uint64 array in the same direction, returns the new boards and the merge scores");
+    m.def("move_batch_kernel", &move_batch_kernel_name, "Name of the move_batch kernel picked for this CPU");
+    m.def("new_game_board", &new_game_board, "Empty board with the two starting tiles");
+    m.def("reset_boards", [](inplace_array<uint64_t> boards) {
+        uint64_t* b = inplace_data(boards, "boards", boards.size());
+        py::gil_scoped_release release;
+        reset_boards(b, boards.size());
+    }, "Reset all boards of a uint64 array in place to new games", py::arg("boards").noconvert());
+    m.def("step_boards", [](inplace_array<uint64_t> boards, py::array_t<int32_t, py::array::c_style | py::array::forcecast> actions,
+                            inplace_array<uint32_t> rewards, inplace_array<bool> dones, bool auto_reset) {
+        const py::ssize_t n = boards.size();
+        uint64_t* b = inplace_data(boards, "boards", n);
+        uint32_t* r = inplace_data(rewards, "rewards", n);
+        uint8_t* d = reinterpret_cast<uint8_t*>(inplace_data(dones, "dones", n));
+        if (actions.ndim() != 1 || actions.size() != n) throw std::invalid_argument("actions must be a 1d array with one entry per board");
+        const int32_t* a = actions.data();
+        py::gil_scoped_release release;
+        step_boards(b, a, r, d, n, auto_reset);
+    }, "Step all boards in place: move, spawn a tile, write the merge score to rewards and the game over flag to dones",
+       py::arg("boards").noconvert(), py::arg("actions"), py::arg("rewards").noconvert(), py::arg("dones").noconvert(), py::arg("auto_reset") = true);
+    m.def("game_over_mask", [](inplace_array<uint64_t> boards, inplace_array<bool> dones) {
+        const py::ssize_t n = boards.size();
+        const uint64_t* b = inplace_data(boards, "boards", n);
+        uint8_t* d = reinterpret_cast<uint8_t*>(inplace_data(dones, "dones", n));
+        py::gil_scoped_release release;
+        game_over_mask(b, d, n);
+    }, "Write the game over flag of every board to dones", py::arg("boards").noconvert(), py::arg("dones").noconvert());
+    m.def("simple_best_moves", [](inplace_array<uint64_t> boards, inplace_array<int32_t> actions, int policy) {
+        const py::ssize_t n = boards.size();
+        const uint64_t* b = inplace_data(boards, "boards", n);
+        int32_t* a = inplace_data(actions, "actions", n);
+        py::gil_scoped_release release;
+        simple_best_moves(b, a, n, policy);
+    }, "Write the compute_simple_best_move action of every board to actions",
+       py::arg("boards").noconvert(), py::arg("actions").noconvert(), py::arg("policy"));
+    m.def("get_stats", []() {
+        return py::module_::import("json").attr("loads")(stats_json(get_stats()));
+    }, "Search counters and latency histograms summed over all threads, all 0 unless built with MCTS2048_STATS=1");
+    m.def("reset_stats", &reset_stats, "Zero the search counters and latency histograms");
+    m.def("stats_enabled", []() { return MCTS2048_STATS != 0; }, "Whether the module was built with MCTS2048_STATS=1");
+    m.def("canonical_board", [](uint64_t board) {
+        const CanonicalBoard canonical = canonical_board(board);
+        return py::make_tuple(canonical.board, canonical.symmetry);
+    }, "Smallest of the 8 symmetries of a board and its index in the order of symmetry_moves", py::arg("board"));
+    m.def("canonicalize_boards", [](py::array_t<uint64_t, py::array::c_style | py::array::forcecast> boards) {
+        const py::ssize_t n = boards.size();
+        py::array_t<uint64_t> canonical(n);
+        py::array_t<uint8_t> symmetries(n);
+        const uint64_t* b = boards.data();
+        uint64_t* c = canonical.mutable_data();
+        uint8_t* s = symmetries.mutable_data();
+        {
+            py::gil_scoped_release release;
+            canonicalize_boards(b, c, s, n);
+        }
+        return py::make_tuple(canonical, symmetries);
+    }, "Canonical form of every board and the index of the symmetry that maps the board to it", py::arg("boards"));
+    m.def("transform_boards", [](py::array_t<uint64_t, py::array::c_style | py::array::forcecast> boards,
+                                 py::array_t<uint8_t, py::array::c_style | py::array::forcecast> symmetries) {
+        const py::ssize_t n = boards.size();
+        if (symmetries.size() != n) throw std::invalid_argument("symmetries must have one entry per board");
+        py::array_t<uint64_t> out(n);
+        const uint64_t* b = boards.data();
+        const uint8_t* s = symmetries.data();
+        uint64_t* o = out.mutable_data();
+        {
+            py::gil_scoped_release release;
+            transform_boards(b, s, o, n);
+        }
+        return out;
+    }, "The symmetries[i]-th symmetry (0-7) of every board", py::arg("boards"), py::arg("symmetries"));
+    m.def("symmetry_moves", []() {
+        py::array_t<uint8_t> moves({8, 4});
+        std::memcpy(moves.mutable_data(), symmetry_moves, sizeof(symmetry_moves));
+        return moves;
+    }, "(8, 4) array, move d on a board is move symmetry_moves()[k, d] on its k-th symmetry");
+    m.def("extract_features", [](py::array_t<uint64_t, py::array::c_style | py::array::forcecast> boards, py::object out) {
+        const py::ssize_t n = boards.size();
+        if (out.is_none()) out = py::array_t<float>({n, (py::ssize_t)n_features});
+        if (!inplace_array<float>::check_(out)) throw std::invalid_argument("out must be a contiguous float32 array");
+        auto features = out.cast<inplace_array<float>>();
+        if (features.ndim() != 2 || features.shape(0) != n || features.shape(1) != n_features) {
+            throw std::invalid_argument("out must be a float32 array of shape (len(boards), 56)");
+        }
+        const uint64_t* b = boards.data();
+        float* f = features.mutable_data();
+        {
+            py::gil_scoped_release release;
+            extract_features(b, f, n);
+        }
+        return out;
+    }, "Write the 56 network input features of every board (see preprocess_board in train.py) to out, a float32 (N, 56) array, and return it",
+       py::arg("boards"), py::arg("out") = py::none());
 };
@@ -0,0 +1,152 @@
+#include "RecordFile.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static RecordFileHeader make_header(int samples, int depth, int policy) {
+    RecordFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, record_file_magic, sizeof(header.magic));
+    header.version = record_file_version;
+    header.header_size = sizeof(RecordFileHeader);
+    header.record_size = sizeof(SelfPlayRecord);
+    header.samples = samples;
+    header.depth = depth;
+    header.policy = policy;
+    return header;
+}
+
+static void check_header(const RecordFileHeader& header, const std::string& path) {
+    if (std::memcmp(header.magic, record_file_magic, sizeof(header.magic)) != 0) {
+        throw std::runtime_error(path + " is not a record file");
+    }
+    if (header.version != record_file_version) {
+        throw std::runtime_error(path + " has record file version " + std::to_string(header.version) +
+                                 ", expected " + std::to_string(record_file_version));
+    }
+    if (header.header_size < sizeof(RecordFileHeader) || header.record_size != sizeof(SelfPlayRecord)) {
+        throw std::runtime_error(path + " has an unsupported header or record size");
+    }
+}
+
+static RecordFileHeader read_header(const std::string& path) {
+    RecordFileHeader header;
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) throw std::runtime_error("cannot open " + path);
+    const size_t read = std::fread(&header, sizeof(header), 1, file);
+    std::fclose(file);
+    if (read != 1) throw std::runtime_error(path + " is too short for a record file");
+    check_header(header, path);
+    return header;
+}
+
+RecordWriter::RecordWriter(const std::string& path, int samples, int depth, int policy) : file_path(path) {
+    std::error_code error;
+    const auto size = std::filesystem::file_size(path, error);
+    if (error || size == 0) {
+        file_header = make_header(samples, depth, policy);
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) throw std::runtime_error("cannot open " + path + " for writing");
+        if (std::fwrite(&file_header, sizeof(file_header), 1, file) != 1 || std::fflush(file) != 0) {
+            std::fclose(file);
+            throw std::runtime_error("writing the header of " + path + " failed");
+        }
+        return;
+    }
+
+    //continue the file: keep the complete records, drop a record that was cut off by a crash
+    file_header = read_header(path);
+    const uint64_t payload = size > file_header.header_size ? size - file_header.header_size : 0;
+    n_records = payload / sizeof(SelfPlayRecord);
+    const uint64_t complete = file_header.header_size + n_records * sizeof(SelfPlayRecord);
+    if (complete != size) std::filesystem::resize_file(path, complete);
+    file = std::fopen(path.c_str(), "ab");
+    if (!file) throw std::runtime_error("cannot open " + path + " for writing");
+}
+
+RecordWriter::~RecordWriter() {
+    if (file) std::fclose(file);
+}
+
+void RecordWriter::append(const SelfPlayRecord* records, size_t n) {
+    if (n == 0) return;
+    const size_t written = std::fwrite(records, sizeof(SelfPlayRecord), n, file);
+    n_records += written;
+    if (written != n || std::fflush(file) != 0) throw std::runtime_error("writing to " + file_path + " failed");
+}
+
+RecordReader::RecordReader(const std::string& path) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("cannot open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(RecordFileHeader)) {
+        ::close(fd);
+        throw std::runtime_error(path + " is too short for a record file");
+    }
+    mapping_size = (size_t)st.st_size;
+    mapping = ::mmap(nullptr, mapping_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        throw std::runtime_error("cannot map " + path);
+    }
+
+    std::memcpy(&file_header, mapping, sizeof(file_header));
+    try {
+        check_header(file_header, path);
+    } catch (...) {
+        ::munmap(mapping, mapping_size);
+        throw;
+    }
+    const size_t payload = mapping_size > file_header.header_size ? mapping_size - file_header.header_size : 0;
+    n_records = payload / sizeof(SelfPlayRecord);
+    records = reinterpret_cast<const SelfPlayRecord*>(static_cast<const char*>(mapping) + file_header.header_size);
+}
+
+RecordReader::~RecordReader() {
+    if (mapping) ::munmap(mapping, mapping_size);
+}
+
+std::pair<size_t, size_t> RecordReader::shard(size_t index, size_t count) const {
+    if (count == 0 || index >= count) throw std::out_of_range("shard index out of range");
+    const size_t base = n_records / count;
+    const size_t extra = n_records % count;
+    const size_t begin = index * base + std::min(index, extra);
+    return {begin, begin + base + (index < extra ? 1 : 0)};
+}
+
+void concat_record_files(const std::string& output, const std::vector<std::string>& inputs) {
+    //settings that differ between the inputs become unknown
+    RecordFileHeader merged = make_header(-1, -1, -1);
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const RecordFileHeader header = read_header(inputs[i]);
+        if (i == 0) {
+            merged.samples = header.samples;
+            merged.depth = header.depth;
+            merged.policy = header.policy;
+        }
+        if (header.samples != merged.samples) merged.samples = -1;
+        if (header.depth != merged.depth) merged.depth = -1;
+        if (header.policy != merged.policy) merged.policy = -1;
+    }
+
+    std::error_code error;
+    for (const std::string& input : inputs) {
+        if (std::filesystem::equivalent(input, output, error)) throw std::invalid_argument(output + " is also an input");
+    }
+    std::filesystem::remove(output, error);
+    RecordWriter writer(output, merged.samples, merged.depth, merged.policy);
+    for (const std::string& input : inputs) {
+        const RecordReader reader(input);
+        const size_t chunk = 1 << 16;
+        for (size_t begin = 0; begin < reader.size(); begin += chunk) {
+            writer.append(reader.data() + begin, std::min(chunk, reader.size() - begin));
+        }
+    }
+}
@@ -0,0 +1,152 @@
+#include "ReplayBuffer.h"
+#include "Random.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static size_t segment_size(size_t capacity) {
+    return sizeof(ReplayBufferHeader) + capacity * (sizeof(uint64_t) + sizeof(SelfPlayRecord));
+}
+
+ReplayBuffer::ReplayBuffer(const std::string& name, size_t capacity)
+    : segment_name(name.empty() || name[0] != '/' ? "/" + name : name), owner(capacity > 0) {
+    if (capacity > (size_t(1) << 31)) throw std::invalid_argument("a replay buffer holds at most 2^31 records");
+
+    int fd;
+    if (owner) {
+        slots = 1;
+        while (slots < capacity) slots <<= 1;
+        mapping_size = segment_size(slots);
+        fd = shm_open(segment_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0) throw std::runtime_error("cannot create the shared memory segment " + segment_name);
+        if (ftruncate(fd, (off_t)mapping_size) != 0) {
+            close(fd);
+            shm_unlink(segment_name.c_str());
+            throw std::runtime_error("cannot size the shared memory segment " + segment_name);
+        }
+    } else {
+        fd = shm_open(segment_name.c_str(), O_RDWR, 0);
+        if (fd < 0) throw std::runtime_error("cannot open the shared memory segment " + segment_name);
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ReplayBufferHeader)) {
+            close(fd);
+            throw std::runtime_error(segment_name + " is not a replay buffer");
+        }
+        mapping_size = (size_t)st.st_size;
+    }
+
+    mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        if (owner) shm_unlink(segment_name.c_str());
+        throw std::runtime_error("cannot map the shared memory segment " + segment_name);
+    }
+
+    if (owner) {
+        //the segment starts zeroed: head 0 and every slot empty. the magic goes last, so that a process
+        //that opens the segment early sees a buffer that is not ready instead of a half written header
+        header = new (mapping) ReplayBufferHeader();
+        header->version = replay_buffer_version;
+        header->record_size = sizeof(SelfPlayRecord);
+        header->capacity = slots;
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(header->magic, replay_buffer_magic, sizeof(header->magic));
+    } else {
+        header = static_cast<ReplayBufferHeader*>(mapping);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        slots = (size_t)header->capacity;
+        std::string error;
+        if (std::memcmp(header->magic, replay_buffer_magic, sizeof(header->magic)) != 0) error = " is not a replay buffer or not ready";
+        else if (header->version != replay_buffer_version) error = " has replay buffer version " + std::to_string(header->version);
+        else if (header->record_size != sizeof(SelfPlayRecord) || slots == 0 || (slots & (slots - 1)) != 0 ||
+                 segment_size(slots) > mapping_size) error = " has an unsupported layout";
+        if (!error.empty()) {
+            munmap(mapping, mapping_size);
+            mapping = nullptr;
+            throw std::runtime_error(segment_name + error);
+        }
+    }
+    sequences = reinterpret_cast<std::atomic<uint64_t>*>(static_cast<char*>(mapping) + sizeof(ReplayBufferHeader));
+    records = reinterpret_cast<SelfPlayRecord*>(static_cast<char*>(mapping) + sizeof(ReplayBufferHeader) + slots * sizeof(uint64_t));
+}
+
+ReplayBuffer::~ReplayBuffer() {
+    if (mapping) munmap(mapping, mapping_size);
+    if (owner) unlink();
+}
+
+void ReplayBuffer::unlink() {
+    if (!owner) return;
+    shm_unlink(segment_name.c_str());
+    owner = false;
+}
+
+size_t ReplayBuffer::size() const {
+    return (size_t)std::min<uint64_t>(pushed(), slots);
+}
+
+// Whether the producer that marked a slot (pid << 1) | 1 may still be writing it: its process exists, or
+// is not ours to signal. a dead child that was not waited for yet still exists
+static bool producer_alive(uint64_t marker) {
+    return kill((pid_t)(marker >> 1), 0) == 0 || errno != ESRCH;
+}
+
+void ReplayBuffer::push(const SelfPlayRecord* in, size_t n) {
+    if (n == 0) return;
+    const uint64_t writing = ((uint64_t)getpid() << 1) | 1;
+    const uint64_t first = header->head.fetch_add(n, std::memory_order_relaxed);
+    for (size_t i = 0; i < n; ++i) {
+        const uint64_t ticket = first + i;
+        const size_t slot = (size_t)ticket & (slots - 1);
+        std::atomic<uint64_t>& sequence = sequences[slot];
+        //claim the slot: a producer a whole ring behind may still be writing it. the slot is theirs until
+        //they publish, however slow, unless their process died: a dead producer's record is lost and the
+        //slot is taken over. a live one is never overwritten, so no copy tears a published record
+        uint64_t current = sequence.load(std::memory_order_relaxed);
+        bool claimed = false;
+        for (unsigned spins = 1; !claimed; ++spins) {
+            if (current & 1) {
+                if (spins % 1024 != 0 || producer_alive(current)) {
+                    if (spins % 64 == 0) std::this_thread::yield();
+                    current = sequence.load(std::memory_order_relaxed);
+                    continue;
+                }
+            } else if (current >= 2 * ticket + 1) {
+                break; //a newer record is in the slot already, this one is dropped
+            }
+            claimed = sequence.compare_exchange_weak(current, writing, std::memory_order_acquire, std::memory_order_relaxed);
+        }
+        if (!claimed) continue;
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(&records[slot], &in[i], sizeof(SelfPlayRecord));
+        sequence.store(2 * ticket + 2, std::memory_order_release);
+    }
+}
+
+size_t ReplayBuffer::sample(SelfPlayRecord* out, size_t n) const {
+    Rng& rng = thread_rng();
+    for (size_t i = 0; i < n; ++i) {
+        while (true) {
+            //one of the newest min(head, capacity) tickets, retried if its slot is empty or being written
+            const uint64_t head = header->head.load(std::memory_order_acquire);
+            const uint64_t available = std::min<uint64_t>(head, slots);
+            if (available == 0) return 0;
+            const size_t slot = (size_t)(head - 1 - rng.bounded((uint32_t)available)) & (slots - 1);
+            const uint64_t before = sequences[slot].load(std::memory_order_acquire);
+            if (before == 0 || (before & 1)) continue;
+            std::memcpy(&out[i], &records[slot], sizeof(SelfPlayRecord));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequences[slot].load(std::memory_order_relaxed) == before) break;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,218 @@
+#include "SearchService.h"
+#include "game.h"
+#include "ThreadPool.h"
+#include "Random.h"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+bool SearchJob::cancel() {
+    Status expected = PENDING;
+    if (job_status.compare_exchange_strong(expected, CANCELLED)) {
+        finish(CANCELLED);
+        return true;
+    }
+    //running: finish() turns the job's end into CANCELLED, whether the search stopped early or not
+    std::lock_guard<std::mutex> lock(mutex);
+    if (job_status.load() != RUNNING) return false;
+    cancel_requested.store(true);
+    return true;
+}
+
+bool SearchJob::wait(int64_t timeout_us) const {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (timeout_us < 0) {
+        cv.wait(lock, [this] { return done(); });
+        return true;
+    }
+    return cv.wait_for(lock, std::chrono::microseconds(timeout_us), [this] { return done(); });
+}
+
+SearchResult SearchJob::result() const {
+    wait();
+    if (status() == CANCELLED) throw std::runtime_error("the search was cancelled");
+    if (error) std::rethrow_exception(error);
+    return job_result;
+}
+
+void SearchJob::on_done(std::function<void(SearchJob&)> callback) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!done()) {
+            callbacks.push_back(std::move(callback));
+            return;
+        }
+    }
+    callback(*this);
+}
+
+void SearchJob::finish(Status final_status) {
+    std::vector<std::function<void(SearchJob&)>> done_callbacks;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job_status.store(cancel_requested.load() ? CANCELLED : final_status);
+        done_callbacks.swap(callbacks);
+    }
+    cv.notify_all();
+    for (auto& callback : done_callbacks) callback(*this);
+}
+
+SearchService::SearchService(int n_threads, uint64_t seed) : seed(seed) {
+    if (n_threads <= 0) n_threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < n_threads; ++i) queues.push_back(std::make_unique<Worker>());
+    for (int i = 0; i < n_threads; ++i) workers.emplace_back([this, i] { worker_loop((size_t)i); });
+}
+
+SearchService::~SearchService() {
+    shutdown();
+}
+
+void SearchService::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        if (stopping.load()) return;
+        stopping.store(true);
+    }
+    for (auto& worker : queues) {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        for (auto& job : worker->queue) job->cancel();
+        n_pending -= worker->queue.size();
+        worker->queue.clear();
+    }
+    sleep_cv.notify_all();
+    for (auto& thread : workers) thread.join();
+}
+
+static bool known_search(const std::string& search) {
+    return search == "mc" || search == "adaptive" || search == "paired" || search == "timed" || search == "expectimax" ||
+           search == "policy";
+}
+
+std::shared_ptr<SearchJob> SearchService::submit(uint64_t board, const SearchConfig& config) {
+    return submit_batch({board}, config).front();
+}
+
+std::vector<std::shared_ptr<SearchJob>> SearchService::submit_batch(const std::vector<uint64_t>& boards, const SearchConfig& config) {
+    if (!known_search(config.search)) throw std::invalid_argument("unknown search " + config.search);
+    if (stopping.load()) throw std::runtime_error("the search service is shutting down");
+    std::vector<std::shared_ptr<SearchJob>> jobs;
+    jobs.reserve(boards.size());
+    for (uint64_t board : boards) {
+        const uint64_t number = next_job.fetch_add(1);
+        jobs.push_back(std::shared_ptr<SearchJob>(new SearchJob(board, config, number)));
+    }
+    //shutdown() sets stopping before it empties a queue under its lock, so a job pushed under the lock
+    //either is seen by shutdown or sees stopping and is dropped here, none stays queued without a worker
+    std::vector<SearchJob*> dropped;
+    for (const auto& job : jobs) {
+        Worker& worker = *queues[job->number % queues.size()];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (stopping.load()) {
+            dropped.push_back(job.get());
+            continue;
+        }
+        worker.queue.push_back(job);
+        n_pending++;
+    }
+    for (SearchJob* job : dropped) job->cancel();
+    {
+        //taking the lock orders the queue pushes before the wakeup, a worker cannot miss them
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+    }
+    if (jobs.size() == 1) sleep_cv.notify_one();
+    else sleep_cv.notify_all();
+    return jobs;
+}
+
+std::shared_ptr<SearchJob> SearchService::take(size_t index) {
+    //own queue from the front, in submission order, other queues from the back
+    {
+        Worker& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.queue.empty()) {
+            auto job = std::move(own.queue.front());
+            own.queue.pop_front();
+            n_pending--;
+            return job;
+        }
+    }
+    for (size_t k = 1; k < queues.size(); ++k) {
+        Worker& victim = *queues[(index + k) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.queue.empty()) {
+            auto job = std::move(victim.queue.back());
+            victim.queue.pop_back();
+            n_pending--;
+            return job;
+        }
+    }
+    return nullptr;
+}
+
+void SearchService::worker_loop(size_t index) {
+    //searches on this thread run the rollout pool inline, every job keeps one core busy
+    ThreadPool::mark_worker_thread();
+    while (true) {
+        if (auto job = take(index)) {
+            run(*job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        if (stopping.load()) return;
+        sleep_cv.wait(lock, [this] { return stopping.load() || n_pending.load() > 0; });
+        if (stopping.load()) return;
+    }
+}
+
+void SearchService::run(SearchJob& job) {
+    SearchJob::Status expected = SearchJob::PENDING;
+    if (!job.job_status.compare_exchange_strong(expected, SearchJob::RUNNING)) return; //cancelled
+
+    const SearchConfig& config = job.config;
+    const uint64_t board = job.job_board;
+    SearchResult& result = job.job_result;
+    const auto start = std::chrono::steady_clock::now();
+    seed_thread_rng(seed, job.number);
+    //cancel() of the running job stops the search at its next task on the rollout pool
+    ThreadPool::set_interrupt_flag(&job.cancel_requested);
+    try {
+        const vector<uint> moves = get_possible_moves(board);
+        if (config.search == "mc" && moves.size() > 1) {
+            const vector<double> scores = compute_scores(board, config.samples, config.depth, config.policy, moves);
+            for (size_t i = 0; i < moves.size(); ++i) result.scores[moves[i]] = scores[i];
+            result.work = (uint64_t)std::max(0, config.samples) * moves.size();
+        } else if (config.search == "adaptive") {
+            const AdaptiveScores scores = compute_adaptive_scores(board, config.samples, config.depth, config.policy, config.z);
+            result.scores = scores.means;
+            result.work = scores.rollouts;
+        } else if (config.search == "paired") {
+            const PairedScores scores = compute_paired_scores(board, config.samples, config.depth, config.policy);
+            result.scores = scores.means;
+            result.work = (uint64_t)scores.samples * moves.size();
+        } else if (config.search == "timed") {
+            const TimedScores scores = compute_timed_scores(board, config.budget_us, config.depth, config.policy);
+            result.scores = scores.means;
+            result.work = scores.rollouts;
+        } else if (config.search == "expectimax") {
+            const vector<double> scores = compute_expectimax_scores(board, config.depth, config.min_probability);
+            std::copy(scores.begin(), scores.end(), result.scores.begin());
+        }
+
+        //best possible move by score, the policy search asks the policy instead
+        if (config.search == "policy") {
+            result.move = compute_simple_best_move(board, config.policy);
+        } else if (!moves.empty()) {
+            result.move = moves[0];
+            for (uint direction : moves) {
+                if (result.scores[direction] > result.scores[result.move]) result.move = direction;
+            }
+        }
+    } catch (const ThreadPool::Interrupted&) {
+        //cancelled, finish() marks the job so
+    } catch (...) {
+        job.error = std::current_exception();
+    }
+    ThreadPool::set_interrupt_flag(nullptr);
+    result.elapsed_us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    job.finish(SearchJob::DONE);
+}
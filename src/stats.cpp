@@ -0,0 +1,135 @@
+#include "Stats.h"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Every thread registers its counters once, the registry keeps them after the thread ends so that
+// the counts of a destroyed worker pool still add up
+static std::mutex registry_mutex;
+static std::vector<std::unique_ptr<ThreadStats>> registry;
+
+ThreadStats& thread_stats() {
+    thread_local ThreadStats* stats = nullptr;
+    if (!stats) {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.push_back(std::make_unique<ThreadStats>());
+        stats = registry.back().get();
+    }
+    return *stats;
+}
+
+void record_latency(StatSearch search, uint64_t ns) {
+    ThreadStats& stats = thread_stats();
+    stat_add(stats.latency[search][latency_bucket(ns)], 1);
+    stat_add(stats.latency_ns[search], ns);
+    if (ns > stats.max_latency_ns[search].load(std::memory_order_relaxed)) {
+        stats.max_latency_ns[search].store(ns, std::memory_order_relaxed);
+    }
+}
+
+// Cycle counter and steady clock at load time, the rate of the cycle counter is measured from there
+static const uint64_t start_cycles = stat_cycles();
+static const auto start_time = std::chrono::steady_clock::now();
+
+SearchStats get_stats() {
+    SearchStats result = {};
+    result.enabled = MCTS2048_STATS != 0;
+    const double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+    result.cycles_per_ns = elapsed_ns > 0 ? (double)(stat_cycles() - start_cycles) / elapsed_ns : 1.0;
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const auto& stats : registry) {
+        for (int i = 0; i < n_stat_counters; ++i) result.counters[i] += stats->counters[i].load(std::memory_order_relaxed);
+        for (int s = 0; s < n_stat_searches; ++s) {
+            for (int b = 0; b < n_latency_buckets; ++b) result.latency[s][b] += stats->latency[s][b].load(std::memory_order_relaxed);
+            result.latency_ns[s] += stats->latency_ns[s].load(std::memory_order_relaxed);
+            result.max_latency_ns[s] = std::max(result.max_latency_ns[s], stats->max_latency_ns[s].load(std::memory_order_relaxed));
+        }
+    }
+    return result;
+}
+
+void reset_stats() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (const auto& stats : registry) {
+        for (auto& counter : stats->counters) counter.store(0, std::memory_order_relaxed);
+        for (int s = 0; s < n_stat_searches; ++s) {
+            for (auto& bucket : stats->latency[s]) bucket.store(0, std::memory_order_relaxed);
+            stats->latency_ns[s].store(0, std::memory_order_relaxed);
+            stats->max_latency_ns[s].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+const char* stat_counter_name(int counter) {
+    static const char* const names[n_stat_counters] = {
+        "rollouts", "rollout_steps", "rollout_game_overs", "timed_steps", "move_cycles", "policy_cycles", "spawn_cycles",
+        "expectimax_nodes", "table_probes", "table_hits", "mcts_iterations",
+    };
+    return counter >= 0 && counter < n_stat_counters ? names[counter] : "";
+}
+
+const char* stat_search_name(int search) {
+    static const char* const names[n_stat_searches] = {"rollout", "expectimax", "mcts"};
+    return search >= 0 && search < n_stat_searches ? names[search] : "";
+}
+
+double latency_quantile_ns(const SearchStats& stats, int search, double q) {
+    uint64_t total = 0;
+    for (uint64_t count : stats.latency[search]) total += count;
+    if (total == 0) return 0;
+    const double target = q * total;
+    uint64_t seen = 0;
+    for (int b = 0; b < n_latency_buckets; ++b) {
+        seen += stats.latency[search][b];
+        if (seen >= target && seen > 0) return std::min((double)stats.max_latency_ns[search], latency_bucket_end(b));
+    }
+    return (double)stats.max_latency_ns[search];
+}
+
+std::string stats_json(const SearchStats& stats) {
+    std::string json;
+    char buffer[256];
+    auto append = [&](const char* format, auto... args) {
+        std::snprintf(buffer, sizeof(buffer), format, args...);
+        json += buffer;
+    };
+    auto ratio = [](double a, double b) {
+        return b > 0 ? a / b : 0.0;
+    };
+
+    append("{\"enabled\": %s, \"cycles_per_ns\": %.4f, \"counters\": {", stats.enabled ? "true" : "false", stats.cycles_per_ns);
+    for (int i = 0; i < n_stat_counters; ++i) {
+        append("%s\"%s\": %llu", i ? ", " : "", stat_counter_name(i), (unsigned long long)stats.counters[i]);
+    }
+
+    //per rollout step times of the timed rollouts, the cycle counts converted with the measured rate
+    const double rollouts = (double)stats.counters[STAT_ROLLOUTS];
+    const double steps = (double)stats.counters[STAT_ROLLOUT_STEPS];
+    const double timed_steps = (double)stats.counters[STAT_TIMED_STEPS];
+    const double ns_per_cycle = ratio(1.0, stats.cycles_per_ns);
+    append("}, \"rollout\": {\"mean_length\": %.3f, \"game_over_fraction\": %.4f, ", ratio(steps, rollouts),
+           ratio((double)stats.counters[STAT_ROLLOUT_GAME_OVERS], rollouts));
+    append("\"move_ns_per_step\": %.3f, \"policy_ns_per_step\": %.3f, \"spawn_ns_per_step\": %.3f}, ",
+           ratio(stats.counters[STAT_MOVE_CYCLES] * ns_per_cycle, timed_steps),
+           ratio(stats.counters[STAT_POLICY_CYCLES] * ns_per_cycle, timed_steps),
+           ratio(stats.counters[STAT_SPAWN_CYCLES] * ns_per_cycle, timed_steps));
+    append("\"table_hit_rate\": %.4f, \"latency\": {",
+           ratio((double)stats.counters[STAT_TABLE_HITS], (double)stats.counters[STAT_TABLE_PROBES]));
+
+    for (int s = 0; s < n_stat_searches; ++s) {
+        uint64_t count = 0;
+        for (uint64_t c : stats.latency[s]) count += c;
+        append("%s\"%s\": {\"count\": %llu, \"mean_us\": %.3f, \"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f, \"buckets\": [",
+               s ? ", " : "", stat_search_name(s), (unsigned long long)count, ratio(stats.latency_ns[s] / 1e3, (double)count),
+               latency_quantile_ns(stats, s, 0.5) / 1e3, latency_quantile_ns(stats, s, 0.9) / 1e3,
+               latency_quantile_ns(stats, s, 0.99) / 1e3, stats.max_latency_ns[s] / 1e3);
+        for (int b = 0; b < n_latency_buckets; ++b) append("%s%llu", b ? ", " : "", (unsigned long long)stats.latency[s][b]);
+        append("]}");
+    }
+    append("}}");
+    return json;
+}
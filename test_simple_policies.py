@@ -1,21 +1,21 @@
-from mcts2048 import initialize_tables, move, add_new_tile, is_game_over, print_board, compute_best_move, compute_simple_best_move
-
-initialize_tables()
+import numpy as np
+from mcts2048 import reset_boards, step_boards, simple_best_moves
 
 
 def eval_simple_best_move(n_games,policy):
+    # all games are played in lockstep, one call per step for the whole batch
+    boards = np.zeros(n_games, dtype=np.uint64)
+    actions = np.zeros(n_games, dtype=np.int32)
+    rewards = np.zeros(n_games, dtype=np.uint32)
+    dones = np.zeros(n_games, dtype=bool)
+    reset_boards(boards) # 2 tiles at the beginning
     score = 0
-    for i in range(n_games):
-        board = 0
-        board = add_new_tile(board)
-        board = add_new_tile(board) # 2 tiles at the beginning
-        for i in range(10000):
-            best_move = compute_simple_best_move(board,policy)
-            board, gain = move(board,best_move)
-            score += gain
-            board = add_new_tile(board)
-            if is_game_over(board):
-                break
+    for i in range(10000):
+        simple_best_moves(boards, actions, policy)
+        step_boards(boards, actions, rewards, dones, auto_reset=False) # finished games stay finished with reward 0
+        score += int(rewards.sum())
+        if dones.all():
+            break
     return score / n_games
 
 for policy in range(5):
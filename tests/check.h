@@ -0,0 +1,39 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cstdio>
+
+// Minimal checks for the tests in this directory. every test is a plain executable that ctest runs: CHECK
+// reports a failed condition and carries on, main returns check_result(), 1 if anything failed
+
+inline int check_failures = 0;
+
+#define CHECK(condition)                                                                  \
+    do {                                                                                  \
+        if (!(condition)) {                                                               \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++check_failures;                                                             \
+        }                                                                                 \
+    } while (0)
+
+// Checks that statement throws an exception of the given type
+#define CHECK_THROWS(statement, exception_type)                                           \
+    do {                                                                                  \
+        bool thrown = false;                                                              \
+        try {                                                                             \
+            statement;                                                                    \
+        } catch (const exception_type&) {                                                 \
+            thrown = true;                                                                \
+        }                                                                                 \
+        if (!thrown) {                                                                    \
+            std::fprintf(stderr, "%s:%d: %s did not throw %s\n", __FILE__, __LINE__, #statement, #exception_type); \
+            ++check_failures;                                                             \
+        }                                                                                 \
+    } while (0)
+
+inline int check_result() {
+    if (check_failures) std::fprintf(stderr, "%d checks failed\n", check_failures);
+    return check_failures ? 1 : 0;
+}
+
+#endif // CHECK_H
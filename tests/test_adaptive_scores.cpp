@@ -0,0 +1,101 @@
+#include "game.h"
+#include "tables.h"
+#include "Random.h"
+#include "check.h"
+#include <cmath>
+#include <initializer_list>
+#include <tuple>
+#include <vector>
+
+// The adaptive rollout search: per move counts within samples, the early stop on boards with a move that
+// is clearly worse, and confidence intervals that contain the means of a much longer compute_scores
+
+static uint64_t from_rows(std::initializer_list<std::initializer_list<unsigned>> rows) {
+    uint64_t board = 0;
+    int cell = 0;
+    for (const auto& row : rows) {
+        for (unsigned rank : row) board |= (uint64_t)rank << (4 * cell++);
+    }
+    return board;
+}
+
+static int total(const AdaptiveScores& result) {
+    return result.counts[0] + result.counts[1] + result.counts[2] + result.counts[3];
+}
+
+int main() {
+    set_seed(19);
+    Rng rng(19);
+    const int samples = 400;
+    const double z = 3;
+
+    //depth 0 rollouts return the merge of the move, without noise: after the first round the moves with
+    //the smaller merge are dropped, left and right merge the same and share the samples
+    {
+        const uint64_t board = from_rows({{3, 3, 1, 0}, {0, 0, 0, 0}, {2, 0, 0, 0}, {0, 0, 0, 0}});
+        const Successors next = successors(board);
+        CHECK(next.legal == 15);
+        const AdaptiveScores result = compute_adaptive_scores(board, samples, 0, 3, z);
+        CHECK(result.best_move == 0 || result.best_move == 1);
+        CHECK(total(result) == result.rollouts);
+        CHECK(result.rollouts < 4 * samples);
+        for (uint d = 0; d < 4; ++d) {
+            CHECK(result.counts[d] == (next.scores[d] == 16 ? samples : 64));
+            CHECK(result.means[d] == next.scores[d]);
+            CHECK(result.half_widths[d] == 0);
+        }
+    }
+
+    //a full board where left and right merge the 1024s of the top row: after left the 2048 sits on the
+    //2048 below it, right moves it away. right is dropped before it has its samples
+    {
+        const uint64_t board = from_rows({{10, 10, 1, 2}, {11, 3, 4, 5}, {2, 5, 3, 6}, {4, 6, 2, 3}});
+        CHECK(successors(board).legal == 3);
+        const AdaptiveScores result = compute_adaptive_scores(board, samples, 10, 3, z);
+        CHECK(result.best_move == 0);
+        CHECK(result.counts[1] < samples);
+        CHECK(result.means[0] - result.half_widths[0] > result.means[1] + result.half_widths[1]);
+    }
+
+    //a single possible move is not searched
+    {
+        const uint64_t board = from_rows({{0, 0, 0, 0}, {1, 2, 1, 2}, {2, 1, 2, 1}, {1, 2, 1, 2}});
+        const AdaptiveScores result = compute_adaptive_scores(board, samples, 10, 3, z);
+        CHECK(successors(board).legal == 4);
+        CHECK(result.rollouts == 0);
+        CHECK(result.best_move == 2);
+    }
+
+    //positions of random games: counts within samples, 0 for the moves that are not possible, and the
+    //intervals contain the means of 20 times the samples
+    int bad_counts = 0, bad_illegal = 0, checked = 0, missed = 0;
+    for (int i = 0; i < 12; ++i) {
+        uint64_t board = new_game_board();
+        for (int step = 0; step < 10 + 8 * i && !is_game_over(board); ++step) {
+            const std::vector<uint> moves = get_possible_moves(board);
+            board = add_new_tile(std::get<0>(move(board, moves[rng.bounded((uint32_t)moves.size())])));
+        }
+        const std::vector<uint> moves = get_possible_moves(board);
+        if (moves.size() < 2) continue;
+        const AdaptiveScores result = compute_adaptive_scores(board, samples, 20, 3, z);
+        const std::vector<double> reference = compute_scores(board, 20 * samples, 20, 3, moves);
+        bad_counts += total(result) != result.rollouts;
+        for (uint d = 0; d < 4; ++d) {
+            bad_counts += result.counts[d] < 0 || result.counts[d] > samples;
+            bool legal = false;
+            for (size_t k = 0; k < moves.size(); ++k) {
+                if (moves[k] != d) continue;
+                legal = true;
+                ++checked;
+                missed += std::fabs(result.means[d] - reference[k] / (20 * samples)) > result.half_widths[d];
+            }
+            if (!legal) bad_illegal += result.counts[d] != 0 || result.means[d] != 0 || result.half_widths[d] != 0;
+        }
+    }
+    CHECK(bad_counts == 0);
+    CHECK(bad_illegal == 0);
+    CHECK(checked > 20);
+    //z = 3 misses 0.3% of the true means, and the long run has noise of its own
+    CHECK(missed * 20 <= checked);
+    return check_result();
+}
@@ -0,0 +1,74 @@
+#include "DatasetGenerator.h"
+#include "RecordFile.h"
+#include "game.h"
+#include "tables.h"
+#include "Random.h"
+#include "check.h"
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+
+// The self-play generator on a record file: a run to N records and a resumed run to 2N with the same
+// seed, whose records must be new games and not the first games again, the scores of the records and a
+// resume with other settings
+
+static bool same_record(const SelfPlayRecord& a, const SelfPlayRecord& b) {
+    return std::memcmp(&a, &b, sizeof(SelfPlayRecord)) == 0;
+}
+
+int main() {
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / ("m2048_test_generator_" + std::to_string(getpid()));
+    std::filesystem::create_directories(dir);
+    const std::string path = (dir / "selfplay.bin").string();
+    const uint64_t n = 400;
+
+    set_seed(2048);
+    {
+        DatasetGenerator generator(path, 20, 5, 3, 64);
+        CHECK(generator.run(n) == n);
+    }
+    set_seed(2048);
+    {
+        DatasetGenerator generator(path, 20, 5, 3, 64);
+        CHECK(generator.run(2 * n) == 2 * n);
+    }
+
+    {
+        RecordReader reader(path);
+        CHECK(reader.size() == 2 * n);
+        //the same board with the same rollout sums comes from the same rng stream: a replayed game
+        uint64_t repeated = 0;
+        for (size_t i = n; i < reader.size(); ++i) {
+            for (size_t j = 0; j < n; ++j) repeated += same_record(reader[i], reader[j]);
+        }
+        CHECK(repeated == 0);
+
+        //only the legal moves are scored, the move played is the best of them
+        uint64_t bad_scores = 0;
+        for (size_t i = 0; i < reader.size(); ++i) {
+            const SelfPlayRecord& record = reader[i];
+            const unsigned legal = successors(record.board).legal;
+            bad_scores += !(legal & (1u << record.move));
+            for (unsigned d = 0; d < 4; ++d) {
+                if (!(legal & (1u << d))) bad_scores += record.scores[d] != 0;
+                else bad_scores += record.scores[d] > record.scores[record.move];
+            }
+            if ((legal & (legal - 1)) == 0) bad_scores += record.scores[record.move] != 1;
+        }
+        CHECK(bad_scores == 0);
+    }
+
+    //a file of other settings is not continued and keeps its records
+    {
+        DatasetGenerator other_samples(path, 40, 5, 3, 64);
+        CHECK_THROWS(other_samples.run(3 * n), std::runtime_error);
+        DatasetGenerator other_policy(path, 20, 5, 1, 64);
+        CHECK_THROWS(other_policy.run(3 * n), std::runtime_error);
+        CHECK(RecordReader(path).size() == 2 * n);
+    }
+
+    std::filesystem::remove_all(dir);
+    return check_result();
+}
@@ -0,0 +1,57 @@
+#include "game.h"
+#include "heuristics.h"
+#include "check.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// The expectimax search and the rollout search on boards without moves and with one move, and the
+// expectimax scores against the definition at depth 1 and against a search on a cold table
+
+int main() {
+    //2 4 2 4 / 4 2 4 2 / ... has no move left
+    const uint64_t game_over = 0x1212212112122121ULL;
+    CHECK(is_game_over(game_over));
+    CHECK(compute_expectimax_move(game_over, 3, 0.0001) == 0);
+    CHECK(compute_best_move(game_over, 10, 10, 0) == 0);
+    const vector<double> over_scores = compute_expectimax_scores(game_over, 3, 0.0001);
+    CHECK(std::all_of(over_scores.begin(), over_scores.end(), [](double score) { return score == 0; }));
+
+    //the same board with the left column cleared: left is the only move, the searches must return it
+    const uint64_t single = game_over & ~0x000F000F000F000FULL;
+    CHECK(get_possible_moves(single) == vector<uint>{0});
+    CHECK(compute_expectimax_move(single, 2, 0.001) == 0);
+    CHECK(compute_best_move(single, 10, 10, 1) == 0);
+    const uint64_t single_right = std::get<0>(move(single, 0));
+    CHECK(get_possible_moves(single_right) == vector<uint>{1});
+    CHECK(compute_expectimax_move(single_right, 2, 0.001) == 1);
+    CHECK(compute_best_move(single_right, 10, 10, 1) == 1);
+
+    //depth 1 is the merge score plus the evaluation of the afterstate
+    for (int i = 0; i < 50; ++i) {
+        uint64_t board = new_game_board();
+        for (int step = 0; step < 40 && !is_game_over(board); ++step) {
+            board = add_new_tile(std::get<0>(move(board, compute_simple_best_move(board, 0))));
+        }
+        if (is_game_over(board)) continue;
+        const vector<double> scores = compute_expectimax_scores(board, 1, 0.0001);
+        for (int direction = 0; direction < 4; ++direction) {
+            const auto [after, gain] = move(board, direction);
+            const double expected = after == board ? 0.0 : gain + evaluate_board(after);
+            CHECK(std::abs(scores[direction] - expected) <= 1e-6 * std::max(1.0, std::abs(expected)));
+        }
+        const uint best = compute_expectimax_move(board, 1, 0.0001);
+        CHECK(can_move(board, best));
+    }
+
+    //a warm table gives the scores of a cold one, up to the float precision of the cached values
+    uint64_t board = new_game_board();
+    for (int step = 0; step < 30; ++step) board = add_new_tile(std::get<0>(move(board, compute_simple_best_move(board, 0))));
+    clear_expectimax_table();
+    const vector<double> cold = compute_expectimax_scores(board, 3, 0.0001);
+    const vector<double> warm = compute_expectimax_scores(board, 3, 0.0001);
+    for (int direction = 0; direction < 4; ++direction) {
+        CHECK(std::abs(cold[direction] - warm[direction]) <= 1e-4 * std::max(1.0, std::abs(cold[direction])));
+    }
+    return check_result();
+}
@@ -0,0 +1,178 @@
+#include "Geometry.h"
+#include "game.h"
+#include "Random.h"
+#include "check.h"
+#include <array>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The board geometries: moves against a plain slide and merge on a cell array, the default board against
+// the engine, the policy numbers of PolicyList, rollout sums and the expectimax search
+
+struct Cells {
+    int size;
+    int cell_bits;
+    std::vector<unsigned> rank;   // row * size + col
+};
+
+static WideBoard to_board(const Cells& cells) {
+    WideBoard board = 0;
+    for (size_t i = 0; i < cells.rank.size(); ++i) board |= (WideBoard)cells.rank[i] << (i * cells.cell_bits);
+    return board;
+}
+
+// Slides every line towards its first cell, merging equal neighbours once unless they hold the largest
+// exponent of a cell. the lines of a direction, cell k of line l: left (l, k), right (l, size-1-k), up
+// (k, l), down (size-1-k, l)
+static std::pair<WideBoard, uint64_t> reference_move(Cells cells, int direction) {
+    const int n = cells.size;
+    const unsigned max_exponent = (1u << cells.cell_bits) - 1;
+    uint64_t score = 0;
+    for (int l = 0; l < n; ++l) {
+        std::vector<int> index(n);
+        for (int k = 0; k < n; ++k) {
+            const int row = direction < 2 ? l : (direction == 2 ? k : n - 1 - k);
+            const int col = direction < 2 ? (direction == 0 ? k : n - 1 - k) : l;
+            index[k] = row * n + col;
+        }
+        std::vector<unsigned> tiles;
+        for (int k = 0; k < n; ++k) {
+            if (cells.rank[index[k]] != 0) tiles.push_back(cells.rank[index[k]]);
+        }
+        std::vector<unsigned> line;
+        for (size_t i = 0; i < tiles.size(); ++i) {
+            if (i + 1 < tiles.size() && tiles[i] == tiles[i + 1] && tiles[i] < max_exponent) {
+                line.push_back(tiles[i] + 1);
+                score += 1ULL << (tiles[i] + 1);
+                ++i;
+            } else {
+                line.push_back(tiles[i]);
+            }
+        }
+        for (int k = 0; k < n; ++k) cells.rank[index[k]] = k < (int)line.size() ? line[k] : 0;
+    }
+    return {to_board(cells), score};
+}
+
+static Cells random_cells(const GeometryFunctions& geometry, Rng& rng) {
+    const unsigned max_exponent = (1u << geometry.cell_bits) - 1;
+    Cells cells = {geometry.size, geometry.cell_bits, std::vector<unsigned>(geometry.size * geometry.size, 0)};
+    //small ranks make merges likely, a few cells hold the largest exponents
+    for (unsigned& rank : cells.rank) {
+        const uint32_t r = rng.bounded(8);
+        if (r < 3) rank = 0;
+        else if (r < 7) rank = 1 + rng.bounded(3);
+        else rank = max_exponent - rng.bounded(2);
+    }
+    return cells;
+}
+
+int main() {
+    Rng rng(29);
+    for (const std::string& name : geometry_names()) {
+        const GeometryFunctions& geometry = geometry_functions(name);
+        int bad_moves = 0, bad_legal = 0, bad_invalid = 0;
+        for (int i = 0; i < 3000; ++i) {
+            const Cells cells = random_cells(geometry, rng);
+            const WideBoard board = to_board(cells);
+            unsigned legal = 0;
+            for (int d = 0; d < 4; ++d) {
+                const auto [after, score] = geometry.move(board, d);
+                if (std::make_pair(after, score) != reference_move(cells, d)) ++bad_moves;
+                legal |= (unsigned)(after != board) << d;
+            }
+            if (legal != geometry.legal_moves(board)) ++bad_legal;
+            for (int d : {-1, 4, 5, 7}) {
+                const auto [after, score] = geometry.move(board, d);
+                if (after != board || score != 0) ++bad_invalid;
+            }
+        }
+        CHECK(bad_moves == 0);
+        CHECK(bad_legal == 0);
+        CHECK(bad_invalid == 0);
+
+        //a finished game: no moves, every search returns move 0
+        Cells full = {geometry.size, geometry.cell_bits, std::vector<unsigned>(geometry.size * geometry.size)};
+        for (int row = 0; row < geometry.size; ++row) {
+            for (int col = 0; col < geometry.size; ++col) full.rank[row * geometry.size + col] = 1 + (row + col) % 2;
+        }
+        const WideBoard over = to_board(full);
+        CHECK(geometry.legal_moves(over) == 0);
+        CHECK(geometry.best_move(over, 10, 5, 3) == 0);
+        CHECK(geometry.expectimax_move(over, 2, 1e-4) == 0);
+        CHECK(geometry.policy_move(over, 1) == 0);
+
+        //depth 0 rollouts score the merge of the move alone, the scores are sums over the samples
+        const Cells cells = random_cells(geometry, rng);
+        const WideBoard board = to_board(cells);
+        const unsigned legal = geometry.legal_moves(board);
+        if ((legal & (legal - 1)) != 0) {
+            const std::array<double, 4> scores = geometry.scores(board, 50, 0, 3);
+            for (int d = 0; d < 4; ++d) {
+                const double expected = (legal & (1u << d)) ? 50.0 * (double)geometry.move(board, d).second : 0.0;
+                CHECK(scores[d] == expected);
+            }
+        }
+        const unsigned move = geometry.expectimax_move(geometry.new_game(), 2, 1e-4);
+        CHECK(move < 4);
+    }
+
+    //4x4x5 merges two 32768 tiles, which do not merge on 4 bit cells
+    const GeometryFunctions& wide = geometry_functions("4x4x5");
+    CHECK(wide.move(((WideBoard)15 << 5) | 15, 0) == std::make_pair((WideBoard)16, (uint64_t)65536));
+    CHECK(wide.max_tile((WideBoard)16) == 65536);
+    const GeometryFunctions& small = geometry_functions("3x3x4");
+    CHECK(small.move(0xFF, 0) == std::make_pair((WideBoard)0xFF, (uint64_t)0));
+    CHECK_THROWS(geometry_functions("6x6x4"), std::invalid_argument);
+
+    //the default board is the engine's: the same moves, policies and expectimax values
+    const GeometryFunctions& standard = geometry_functions("4x4x4");
+    int bad_engine_moves = 0, bad_policies = 0, bad_expectimax = 0;
+    for (int i = 0; i < 300; ++i) {
+        const Cells cells = random_cells(standard, rng);
+        const uint64_t board = (uint64_t)to_board(cells);
+        for (int d = 0; d < 4; ++d) {
+            const auto [after, score] = move(board, d);
+            if (standard.move(board, d) != std::make_pair((WideBoard)after, (uint64_t)score)) ++bad_engine_moves;
+        }
+        if (is_game_over(board)) continue;
+        //the policies that draw no random numbers
+        for (int policy : {0, 1, 2, 5}) {
+            if (standard.policy_move(board, policy) != compute_simple_best_move(board, policy)) ++bad_policies;
+        }
+        if (i % 30 == 0) {
+            clear_expectimax_table();
+            const std::vector<double> engine = compute_expectimax_scores(board, 2, 1e-4);
+            clear_expectimax_table();
+            const std::array<double, 4> scores = standard.expectimax_scores(board, 2, 1e-4);
+            for (int d = 0; d < 4; ++d) {
+                if (std::fabs(engine[d] - scores[d]) > 1e-6 * std::fabs(engine[d])) ++bad_expectimax;
+            }
+        }
+    }
+    CHECK(bad_engine_moves == 0);
+    CHECK(bad_policies == 0);
+    CHECK(bad_expectimax == 0);
+
+    //policy numbers: the 4x4 only policies and unknown numbers play policy 2, max merge is after PolicyList
+    int bad_numbers = 0;
+    for (int i = 0; i < 300; ++i) {
+        const WideBoard board = to_board(random_cells(small, rng));
+        const unsigned legal = small.legal_moves(board);
+        if (legal == 0) continue;
+        for (int policy : {0, 4, 5, 6, 7, 8, -1, 42}) {
+            if (small.policy_move(board, policy) != small.policy_move(board, 2)) ++bad_numbers;
+        }
+        unsigned best = 4;
+        for (unsigned d = 0; d < 4; ++d) {
+            if (!(legal & (1u << d))) continue;
+            if (best == 4 || small.move(board, d).second > small.move(board, best).second) best = d;
+        }
+        if (small.policy_move(board, max_merge_policy) != best) ++bad_numbers;
+    }
+    CHECK(bad_numbers == 0);
+    return check_result();
+}
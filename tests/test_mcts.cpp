@@ -0,0 +1,89 @@
+#include "MCTS.h"
+#include "game.h"
+#include "tables.h"
+#include "Random.h"
+#include "check.h"
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+// The MCTS search: legal moves from search and search_for, the arena within its capacity also when it
+// fills in the middle of an expansion, and the subtree kept by a search from a spawn outcome of the tree
+
+// A board of a game played with random moves for the given number of steps
+static uint64_t random_position(Rng& rng, int steps) {
+    uint64_t board = new_game_board();
+    for (int i = 0; i < steps && !is_game_over(board); ++i) {
+        const std::vector<uint> moves = get_possible_moves(board);
+        board = add_new_tile(std::get<0>(move(board, moves[rng.bounded((uint32_t)moves.size())])));
+    }
+    return board;
+}
+
+static unsigned total_visits(const MCTS& mcts) {
+    const std::vector<unsigned> visits = mcts.root_visits();
+    return std::accumulate(visits.begin(), visits.end(), 0u);
+}
+
+int main() {
+    set_seed(6);
+    Rng rng(6);
+
+    //legal moves, from searches that fit in the arena and from searches that fill it
+    int bad_moves = 0, over_capacity = 0;
+    for (int i = 0; i < 40; ++i) {
+        const uint64_t board = random_position(rng, 20 + 10 * (i % 8));
+        if (is_game_over(board)) continue;
+        const unsigned legal = successors(board).legal;
+        MCTS large(1 << 14, 1.0, 10, 2);
+        MCTS small(64, 1.0, 10, 2);
+        bad_moves += !(legal & (1u << large.search(board, 200)));
+        bad_moves += !(legal & (1u << small.search(board, 300)));
+        bad_moves += !(legal & (1u << small.search_for(board, 2000).move));
+        over_capacity += large.size() > large.capacity();
+        over_capacity += small.size() > small.capacity();
+    }
+    CHECK(bad_moves == 0);
+    CHECK(over_capacity == 0);
+
+    //an arena of 2 nodes has no room for the moves of the root: the expansion is dropped with its nodes
+    {
+        const uint64_t board = random_position(rng, 30);
+        const unsigned legal = successors(board).legal;
+        CHECK((legal & (legal - 1)) != 0);
+        MCTS tiny(2, 1.0, 10, 2);
+        CHECK(legal & (1u << tiny.search(board, 20)));
+        CHECK(tiny.size() == 1);
+        CHECK(total_visits(tiny) == 0);
+    }
+
+    //tree reuse: a search from a spawn outcome of the best move keeps the visits of that subtree, a
+    //board that is not in the tree starts a new one
+    {
+        const uint64_t board = random_position(rng, 40);
+        MCTS mcts(1 << 16, 1.0, 10, 2);
+        const unsigned best = mcts.search(board, 3000);
+        CHECK(total_visits(mcts) == 3000);
+        const size_t full_size = mcts.size();
+
+        const uint64_t after = std::get<0>(move(board, best));
+        unsigned most_kept = 0;
+        size_t kept_size = 0;
+        for (int cell = 0; cell < 16; ++cell) {
+            if ((after >> (4 * cell)) & 0xF) continue;
+            MCTS reused = mcts;
+            reused.search(after | (1ULL << (4 * cell)), 10);
+            if (total_visits(reused) > most_kept) {
+                most_kept = total_visits(reused);
+                kept_size = reused.size();
+            }
+        }
+        CHECK(most_kept > 10 + 10);
+        CHECK(kept_size > 1 && kept_size < full_size);
+
+        MCTS unrelated = mcts;
+        unrelated.search(random_position(rng, 60), 10);
+        CHECK(total_visits(unrelated) == 10);
+    }
+    return check_result();
+}
@@ -0,0 +1,91 @@
+#include "game.h"
+#include "Random.h"
+#include "check.h"
+#include <tuple>
+#include <vector>
+
+// move_batch, on every kernel it picks, against move() and against a plain reference slide of the
+// rows. n is odd so that the scalar tail after the 4-wide blocks is covered too
+
+// Cell (row, col) of board, for the direction's view of it: every direction slides its lines towards col 0
+static int cell(uint64_t board, int direction, int line, int i) {
+    const int col = direction == 0 ? i : direction == 1 ? 3 - i : line;
+    const int row = direction <= 1 ? line : direction == 2 ? i : 3 - i;
+    return (board >> (4 * (row * 4 + col))) & 0xF;
+}
+
+static uint64_t reference_move(uint64_t board, int direction) {
+    uint64_t out = 0;
+    for (int line = 0; line < 4; ++line) {
+        std::vector<int> tiles;
+        for (int i = 0; i < 4; ++i) {
+            if (int tile = cell(board, direction, line, i)) tiles.push_back(tile);
+        }
+        std::vector<int> merged;
+        for (size_t i = 0; i < tiles.size(); ++i) {
+            //15 is the largest tile of a nibble, two of them do not merge
+            if (i + 1 < tiles.size() && tiles[i] == tiles[i + 1] && tiles[i] != 15) {
+                merged.push_back(tiles[i] + 1);
+                ++i;
+            } else {
+                merged.push_back(tiles[i]);
+            }
+        }
+        for (int i = 0; i < (int)merged.size(); ++i) {
+            const int col = direction == 0 ? i : direction == 1 ? 3 - i : line;
+            const int row = direction <= 1 ? line : direction == 2 ? i : 3 - i;
+            out |= (uint64_t)merged[i] << (4 * (row * 4 + col));
+        }
+    }
+    return out;
+}
+
+int main() {
+    Rng rng(7);
+    const size_t n = 10007;
+    std::vector<uint64_t> boards(n);
+    for (auto& board : boards) {
+        board = 0;
+        //sparse and crowded boards, a few with 15-tiles
+        const uint32_t fill = rng.bounded(17);
+        for (int c = 0; c < 16; ++c) {
+            if (rng.bounded(16) < fill) board |= (uint64_t)(1 + rng.bounded(rng.bounded(8) == 0 ? 15 : 6)) << (4 * c);
+        }
+    }
+    std::vector<int32_t> directions(n);
+    for (auto& direction : directions) direction = (int32_t)rng.bounded(6) - 1; //-1 and 4 are invalid
+
+    std::vector<uint64_t> out_boards(n);
+    std::vector<uint32_t> out_scores(n);
+    move_batch(boards.data(), directions.data(), out_boards.data(), out_scores.data(), n);
+    int mismatches = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const int direction = directions[i];
+        uint64_t expected = boards[i];
+        uint expected_score = 0;
+        if (direction >= 0 && direction <= 3) {
+            std::tie(expected, expected_score) = move(boards[i], direction);
+            if (expected != reference_move(boards[i], direction)) ++mismatches;
+        }
+        if (out_boards[i] != expected || out_scores[i] != expected_score) ++mismatches;
+    }
+    CHECK(mismatches == 0);
+
+    for (int direction = -1; direction <= 4; ++direction) {
+        move_batch(boards.data(), direction, out_boards.data(), out_scores.data(), n);
+        mismatches = 0;
+        for (size_t i = 0; i < n; ++i) {
+            uint64_t expected = boards[i];
+            uint expected_score = 0;
+            if (direction >= 0 && direction <= 3) std::tie(expected, expected_score) = move(boards[i], direction);
+            if (out_boards[i] != expected || out_scores[i] != expected_score) ++mismatches;
+        }
+        CHECK(mismatches == 0);
+    }
+
+    //2 2 4 . slides left to 4 4 . . for 4 points, a tile merges once per move
+    const uint64_t row = 0x0211;
+    CHECK(std::get<0>(move(row, 0)) == 0x0022);
+    CHECK(std::get<1>(move(row, 0)) == 4);
+    return check_result();
+}
@@ -0,0 +1,79 @@
+#include "Network.h"
+#include "Random.h"
+#include "check.h"
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// Network::forward on batches of every size against a plain evaluation of one sample at a time, and the
+// weight file checks
+
+int main() {
+    const std::string path = (std::filesystem::temp_directory_path() / ("m2048_test_network_" + std::to_string(getpid()) + ".bin")).string();
+    //widths that are not multiples of 8 or 16, so that the kernels' remainders are used
+    const std::vector<uint32_t> widths = {56, 40, 12, 4};
+    std::vector<std::vector<float>> weights, biases;
+    Rng rng(11);
+    {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        const uint32_t version = 1, n_layers = (uint32_t)widths.size() - 1;
+        std::fwrite("M2048MLP", 1, 8, file);
+        std::fwrite(&version, sizeof(version), 1, file);
+        std::fwrite(&n_layers, sizeof(n_layers), 1, file);
+        std::fwrite(widths.data(), sizeof(uint32_t), widths.size(), file);
+        for (uint32_t l = 0; l < n_layers; ++l) {
+            weights.emplace_back(widths[l] * widths[l + 1]);
+            biases.emplace_back(widths[l + 1]);
+            for (float& w : weights.back()) w = (float)(rng.uniform() - 0.5);
+            for (float& b : biases.back()) b = (float)(rng.uniform() - 0.5);
+            std::fwrite(weights.back().data(), sizeof(float), weights.back().size(), file);
+            std::fwrite(biases.back().data(), sizeof(float), biases.back().size(), file);
+        }
+        std::fclose(file);
+    }
+    Network network(path);
+    CHECK(network.input_size() == 56 && network.output_size() == 4);
+
+    const size_t n = 23;
+    std::vector<float> inputs(n * 56);
+    for (float& x : inputs) x = (float)rng.uniform();
+    std::vector<float> expected(n * 4);
+    for (size_t s = 0; s < n; ++s) {
+        std::vector<float> x(inputs.begin() + s * 56, inputs.begin() + (s + 1) * 56);
+        for (size_t l = 0; l + 1 < widths.size(); ++l) {
+            std::vector<float> y(widths[l + 1]);
+            for (uint32_t o = 0; o < widths[l + 1]; ++o) {
+                double sum = biases[l][o];
+                for (uint32_t i = 0; i < widths[l]; ++i) sum += (double)weights[l][o * widths[l] + i] * x[i];
+                y[o] = l + 2 < widths.size() ? (float)(sum / (1 + std::exp(-sum))) : (float)sum;
+            }
+            x = y;
+        }
+        std::copy(x.begin(), x.end(), expected.begin() + s * 4);
+    }
+
+    //every batch size from 1 to n, on a slice that starts at sample 0
+    for (size_t batch = 1; batch <= n; ++batch) {
+        std::vector<float> outputs(batch * 4);
+        network.forward(inputs.data(), outputs.data(), batch);
+        bool close = true;
+        for (size_t k = 0; k < batch * 4; ++k) close = close && std::abs(outputs[k] - expected[k]) <= 1e-4f;
+        CHECK(close);
+    }
+
+    //a truncated file and a file of something else
+    std::filesystem::resize_file(path, 8 + 4 + 4 + 16 + 100);
+    CHECK_THROWS(Network truncated(path), std::runtime_error);
+    {
+        std::FILE* file = std::fopen(path.c_str(), "wb");
+        std::fwrite("NOTANET!", 1, 8, file);
+        std::fclose(file);
+    }
+    CHECK_THROWS(Network other(path), std::runtime_error);
+    std::filesystem::remove(path);
+    return check_result();
+}
@@ -0,0 +1,53 @@
+#include "NTupleNetwork.h"
+#include "game.h"
+#include "tables.h"
+#include "check.h"
+#include <cmath>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// The n-tuple network: values are the same on all symmetries of a board, a weight file round trip, and
+// training on several threads (the tables are shared without locks, run it under TSan to check that)
+
+int main() {
+    set_num_threads(4);
+    using Tuples = std::vector<NTupleNetwork::Tuple>;
+    NTupleNetwork network(Tuples{{0, 1, 2, 3, 4, 5}, {0, 1, 2, 4, 5, 6}});
+    CHECK_THROWS(NTupleNetwork bad(Tuples{{0, 1, 2, 3, 4, 16}}), std::invalid_argument);
+
+    const NTupleNetwork::TrainingResult result = network.train(200, 0.1f);
+    CHECK(result.games == 200);
+    CHECK(network.games_trained() == 200);
+    CHECK(result.mean_score > 0 && result.max_score >= result.mean_score);
+
+    const uint64_t board = 0x0000001200230145ULL;
+    const float value = network.evaluate(board);
+    CHECK(std::isfinite(value));
+    uint64_t symmetries[8];
+    board_symmetries(board, symmetries);
+    for (uint64_t symmetric : symmetries) CHECK(std::abs(network.evaluate(symmetric) - value) <= 1e-3f * std::max(1.0f, std::abs(value)));
+
+    network.update(board, 100.0f);
+    CHECK(network.evaluate(board) > value);
+
+    const std::string path = (std::filesystem::temp_directory_path() / ("m2048_test_ntuple_" + std::to_string(getpid()) + ".bin")).string();
+    network.save(path);
+    {
+        NTupleNetwork loaded(path);
+        CHECK(loaded.get_tuples() == network.get_tuples());
+        bool same = true;
+        uint64_t b = new_game_board();
+        for (int step = 0; step < 200 && !is_game_over(b); ++step) {
+            same = same && loaded.evaluate(b) == network.evaluate(b);
+            b = add_new_tile(std::get<0>(move(b, compute_simple_best_move(b, 0))));
+        }
+        CHECK(same);
+    }
+    std::filesystem::resize_file(path, 40);
+    CHECK_THROWS(NTupleNetwork truncated(path), std::runtime_error);
+    std::filesystem::remove(path);
+    return check_result();
+}
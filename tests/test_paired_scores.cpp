@@ -0,0 +1,137 @@
+#include "game.h"
+#include "policies.h"
+#include "Random.h"
+#include "check.h"
+#include <cmath>
+#include <cstdlib>
+#include <initializer_list>
+#include <tuple>
+
+// The paired rollout search: the common random spawn, uniform over the empty cells and the same on two
+// boards wherever their empty cells allow, and a paired difference error well below the error of two
+// independent means on boards whose moves share a large part of their rollout noise. then the results on
+// game positions: differences that are those of the means, the same with any number of workers, and 0
+// for the moves that are not possible
+
+static uint64_t from_rows(std::initializer_list<std::initializer_list<unsigned>> rows) {
+    uint64_t board = 0;
+    int cell = 0;
+    for (const auto& row : rows) {
+        for (unsigned rank : row) board |= (uint64_t)rank << (4 * cell++);
+    }
+    return board;
+}
+
+static int spawned_cell(uint64_t before, uint64_t after) {
+    return __builtin_ctzll(before ^ after) / 4;
+}
+
+// Paired error of moves a and b over the error of the difference of two independent means
+static double error_ratio(const PairedScores& scores, unsigned a, unsigned b) {
+    const double independent = std::sqrt(scores.std_errors[a] * scores.std_errors[a] + scores.std_errors[b] * scores.std_errors[b]);
+    return scores.difference_errors[a][b] / independent;
+}
+
+int main() {
+    //the spawn: every empty cell as often, 10% fours, full cells never
+    {
+        const uint64_t board = from_rows({{1, 1, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 3}, {0, 0, 0, 0}});
+        const int n = 130000;
+        int cells[16] = {}, fours = 0;
+        for (int j = 0; j < n; ++j) {
+            CounterRng rng(17, (uint64_t)j);
+            const uint64_t after = spawn_tile_common(board, 0, rng);
+            const int cell = spawned_cell(board, after);
+            cells[cell]++;
+            fours += ((after >> (4 * cell)) & 0xF) == 2;
+        }
+        int bad_cells = 0;
+        for (int cell = 0; cell < 16; ++cell) {
+            const bool full = cell == 0 || cell == 1 || cell == 11;
+            if (full) bad_cells += cells[cell] != 0;
+            else bad_cells += std::abs(cells[cell] - n / 13) > 400; //10000 per cell, 4 standard deviations
+        }
+        CHECK(bad_cells == 0);
+        CHECK(std::abs(fours - n / 10) < 400);
+        CounterRng rng(17, 0);
+        CHECK(spawn_tile_common(0xFFFFFFFFFFFFFFFFULL, 0, rng) == 0xFFFFFFFFFFFFFFFFULL);
+    }
+
+    //two boards that differ in one cell, empty on the first: the same spawn whenever the first board does
+    //not spawn on that cell
+    {
+        const uint64_t first = from_rows({{1, 0, 0, 0}, {0, 0, 0, 0}, {0, 2, 0, 0}, {0, 0, 0, 0}});
+        const uint64_t second = first | (3ULL << (4 * 6));
+        int other_spawn = 0;
+        for (int j = 0; j < 20000; ++j) {
+            CounterRng rng(18, (uint64_t)j);
+            const uint64_t a = spawn_tile_common(first, 0, rng);
+            const uint64_t b = spawn_tile_common(second, 0, rng);
+            if (spawned_cell(first, a) != 6) other_spawn += (a ^ first) != (b ^ second);
+        }
+        CHECK(other_spawn == 0);
+    }
+
+    //a pending 1024 merge in the bottom rows that left and right both keep: the random policy makes it or
+    //not with the same draw on both rollouts
+    set_seed(24);
+    {
+        const uint64_t board = from_rows({{0, 3, 0, 0}, {0, 0, 0, 0}, {9, 1, 2, 1}, {9, 2, 1, 2}});
+        const PairedScores scores = compute_paired_scores(board, 2000, 3, 3);
+        CHECK(error_ratio(scores, 0, 1) < 0.7);
+    }
+    //a single tile: after left or right the first move policy slides both rollouts the same way
+    {
+        const uint64_t board = from_rows({{0, 1, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}, {0, 0, 0, 0}});
+        const PairedScores scores = compute_paired_scores(board, 2000, 10, 2);
+        CHECK(error_ratio(scores, 0, 1) < 0.7);
+    }
+
+    //game positions: the differences are the differences of the means, the same result with one and with
+    //several workers, and 0 for the moves that are not possible
+    int bad_differences = 0, bad_threads = 0, bad_illegal = 0, positions = 0;
+    uint64_t board = new_game_board();
+    for (int step = 0; positions < 12; ++step) {
+        if (is_game_over(board)) board = new_game_board();
+        const unsigned legal = successors(board).legal;
+        if (step % 7 == 0 && (legal & (legal - 1)) != 0) {
+            ++positions;
+            set_num_threads(1);
+            set_seed(step);
+            const PairedScores one = compute_paired_scores(board, 300, 20, 3);
+            set_num_threads(3);
+            set_seed(step);
+            const PairedScores several = compute_paired_scores(board, 300, 20, 3);
+            bad_threads += one.best_move != several.best_move || one.means != several.means || one.std_errors != several.std_errors ||
+                           one.differences != several.differences || one.difference_errors != several.difference_errors;
+            for (unsigned a = 0; a < 4; ++a) {
+                for (unsigned b = 0; b < 4; ++b) {
+                    const bool both = (legal & (1u << a)) && (legal & (1u << b)) && a != b;
+                    if (both) {
+                        const double expected = one.means[a] - one.means[b];
+                        bad_differences += std::fabs(one.differences[a][b] - expected) > 1e-9 * (1 + std::fabs(one.means[a]));
+                        bad_differences += one.difference_errors[a][b] != one.difference_errors[b][a];
+                    } else {
+                        bad_illegal += one.differences[a][b] != 0 || one.difference_errors[a][b] != 0;
+                    }
+                }
+                if (!(legal & (1u << a))) bad_illegal += one.means[a] != 0 || one.std_errors[a] != 0;
+            }
+            bad_illegal += !(legal & (1u << one.best_move));
+        }
+        board = add_new_tile(std::get<0>(move(board, compute_simple_best_move(board, 0))));
+    }
+    set_num_threads(1);
+    CHECK(bad_differences == 0);
+    CHECK(bad_threads == 0);
+    CHECK(bad_illegal == 0);
+
+    //a single possible move: nothing to compare
+    {
+        const uint64_t single = from_rows({{0, 0, 0, 0}, {1, 2, 1, 2}, {2, 1, 2, 1}, {1, 2, 1, 2}});
+        const PairedScores scores = compute_paired_scores(single, 300, 20, 3);
+        CHECK(scores.best_move == 2);
+        CHECK(scores.means[2] == 0 && scores.differences[2][0] == 0);
+    }
+    return check_result();
+}
@@ -0,0 +1,120 @@
+#include "RecordFile.h"
+#include "check.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// Record files: a write, reopen and append round trip, a record cut off at the end, bad headers, shards
+// and concatenation
+
+static SelfPlayRecord make_record(uint64_t i) {
+    SelfPlayRecord record = {};
+    record.board = i * 0x9E3779B97F4A7C15ULL;
+    for (int d = 0; d < 4; ++d) record.scores[d] = (float)(i + d);
+    record.move = (uint8_t)(i & 3);
+    record.reward = (uint32_t)(i * 4);
+    return record;
+}
+
+static bool records_match(const RecordReader& reader, uint64_t first) {
+    for (size_t i = 0; i < reader.size(); ++i) {
+        const SelfPlayRecord expected = make_record(first + i);
+        if (std::memcmp(&reader[i], &expected, sizeof(expected)) != 0) return false;
+    }
+    return true;
+}
+
+static void write_records(RecordWriter& writer, uint64_t first, uint64_t n) {
+    std::vector<SelfPlayRecord> records;
+    for (uint64_t i = first; i < first + n; ++i) records.push_back(make_record(i));
+    writer.append(records.data(), records.size());
+}
+
+int main() {
+    const std::filesystem::path dir = std::filesystem::temp_directory_path() / ("m2048_test_records_" + std::to_string(getpid()));
+    std::filesystem::create_directories(dir);
+    const std::string path = (dir / "a.bin").string();
+
+    {
+        RecordWriter writer(path, 100, 10, 3);
+        CHECK(writer.size() == 0);
+        write_records(writer, 0, 100);
+        CHECK(writer.size() == 100);
+    }
+    CHECK(std::filesystem::file_size(path) == 64 + 100 * 32);
+    {
+        //reopening continues the file and keeps the settings of its header
+        RecordWriter writer(path, 1, 1, 1);
+        CHECK(writer.size() == 100);
+        CHECK(writer.header().samples == 100 && writer.header().policy == 3);
+        write_records(writer, 100, 50);
+    }
+    {
+        RecordReader reader(path);
+        CHECK(reader.size() == 150);
+        CHECK(reader.header().depth == 10);
+        CHECK(records_match(reader, 0));
+    }
+
+    //a record cut off by a crash is not read, and the writer drops it before it appends
+    std::filesystem::resize_file(path, 64 + 150 * 32 - 10);
+    {
+        RecordReader reader(path);
+        CHECK(reader.size() == 149);
+    }
+    {
+        RecordWriter writer(path);
+        CHECK(writer.size() == 149);
+        write_records(writer, 149, 1);
+    }
+    {
+        RecordReader reader(path);
+        CHECK(reader.size() == 150);
+        CHECK(records_match(reader, 0));
+
+        //shards cover the file once, in order, sizes differ by at most one
+        size_t next = 0;
+        for (size_t index = 0; index < 7; ++index) {
+            const auto [begin, end] = reader.shard(index, 7);
+            CHECK(begin == next);
+            CHECK(end - begin == 21 || end - begin == 22);
+            next = end;
+        }
+        CHECK(next == 150);
+        CHECK_THROWS(reader.shard(7, 7), std::out_of_range);
+    }
+
+    //concatenation keeps the settings the inputs agree on
+    const std::string second = (dir / "b.bin").string();
+    {
+        RecordWriter writer(second, 100, 20, 3);
+        write_records(writer, 150, 30);
+    }
+    const std::string joined = (dir / "joined.bin").string();
+    concat_record_files(joined, {path, second});
+    {
+        RecordReader reader(joined);
+        CHECK(reader.size() == 180);
+        CHECK(records_match(reader, 0));
+        CHECK(reader.header().samples == 100 && reader.header().depth == -1 && reader.header().policy == 3);
+    }
+
+    //files that are not record files
+    const std::string bad = (dir / "bad.bin").string();
+    {
+        std::FILE* file = std::fopen(bad.c_str(), "wb");
+        const char junk[100] = "definitely not a record file";
+        std::fwrite(junk, 1, sizeof(junk), file);
+        std::fclose(file);
+    }
+    CHECK_THROWS(RecordReader reader(bad), std::runtime_error);
+    CHECK_THROWS(RecordWriter writer(bad), std::runtime_error);
+    CHECK_THROWS(RecordReader reader((dir / "missing.bin").string()), std::runtime_error);
+
+    std::filesystem::remove_all(dir);
+    return check_result();
+}
@@ -0,0 +1,167 @@
+#include "ReplayBuffer.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// The shared memory replay buffer: create and open errors, an empty buffer, pushes and samples from
+// threads and a forked process with no torn record, and a slot left half written by a producer, which is
+// taken over once that producer's process is dead and waited for as long as it lives
+
+// Record i, every field follows from reward = i, so a record mixed from two pushes does not check
+static SelfPlayRecord make_record(uint32_t i) {
+    SelfPlayRecord record = {};
+    record.board = i * 0x9E3779B97F4A7C15ULL;
+    for (int d = 0; d < 4; ++d) record.scores[d] = (float)(i + d);
+    record.move = (uint8_t)(i & 3);
+    record.reward = i;
+    return record;
+}
+
+static bool whole(const SelfPlayRecord& record) {
+    const SelfPlayRecord expected = make_record(record.reward);
+    return std::memcmp(&record, &expected, sizeof(expected)) == 0;
+}
+
+static void push_range(ReplayBuffer& buffer, uint32_t first, uint32_t n) {
+    std::vector<SelfPlayRecord> batch;
+    for (uint32_t i = first; i < first + n; ++i) {
+        batch.push_back(make_record(i));
+        if (batch.size() == 7) {
+            buffer.push(batch.data(), batch.size());
+            batch.clear();
+        }
+    }
+    buffer.push(batch.data(), batch.size());
+}
+
+// Samples until stop is set, returns the number of torn records
+static int sample_until(const ReplayBuffer& buffer, const std::atomic<bool>& stop) {
+    int torn = 0;
+    SelfPlayRecord out[16];
+    while (!stop.load()) {
+        const size_t n = buffer.sample(out, 16);
+        for (size_t i = 0; i < n; ++i) torn += !whole(out[i]);
+    }
+    return torn;
+}
+
+// Marks the slot of the next push as being written by pid, as a producer that stopped in the middle does
+static void mark_next_slot(const ReplayBuffer& buffer, pid_t pid) {
+    const int fd = shm_open(buffer.name().c_str(), O_RDWR, 0);
+    const size_t size = sizeof(ReplayBufferHeader) + buffer.capacity() * sizeof(uint64_t);
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    auto* sequences = reinterpret_cast<std::atomic<uint64_t>*>(static_cast<char*>(mapping) + sizeof(ReplayBufferHeader));
+    sequences[buffer.pushed() & (buffer.capacity() - 1)].store(((uint64_t)pid << 1) | 1);
+    munmap(mapping, size);
+}
+
+static bool newest_is(const ReplayBuffer& buffer, uint32_t reward) {
+    //the newest record is one of capacity, sampling it once in a while is enough
+    SelfPlayRecord out[64];
+    for (int k = 0; k < 100; ++k) {
+        const size_t n = buffer.sample(out, 64);
+        for (size_t i = 0; i < n; ++i) {
+            if (out[i].reward == reward) return whole(out[i]);
+        }
+    }
+    return false;
+}
+
+int main() {
+    const std::string name = "/m2048_test_replay_" + std::to_string(getpid());
+    {
+        ReplayBuffer buffer(name, 100);
+        CHECK(buffer.capacity() == 128);
+        CHECK(buffer.size() == 0);
+        SelfPlayRecord out[8];
+        CHECK(buffer.sample(out, 8) == 0);
+        CHECK_THROWS(ReplayBuffer(name, 16), std::runtime_error);
+        CHECK_THROWS(ReplayBuffer(name + "_missing"), std::runtime_error);
+
+        //a second handle sees the pushes of the first, once the ring is full only the newest records
+        ReplayBuffer reader(name);
+        CHECK(reader.capacity() == 128);
+        push_range(buffer, 0, 300);
+        CHECK(reader.pushed() == 300);
+        CHECK(reader.size() == 128);
+        bool all_newest = true;
+        for (int k = 0; k < 50; ++k) {
+            CHECK(reader.sample(out, 8) == 8);
+            for (const SelfPlayRecord& record : out) all_newest &= whole(record) && record.reward >= 300 - 128;
+        }
+        CHECK(all_newest);
+
+        //producer threads and a sampler
+        std::atomic<bool> stop{false};
+        int torn = 0;
+        std::thread sampler([&] { torn = sample_until(reader, stop); });
+        std::vector<std::thread> producers;
+        for (uint32_t t = 0; t < 3; ++t) producers.emplace_back([&buffer, t] { push_range(buffer, 1000 + t * 20000, 20000); });
+        for (auto& producer : producers) producer.join();
+        stop.store(true);
+        sampler.join();
+        CHECK(torn == 0);
+        CHECK(buffer.pushed() == 300 + 3 * 20000);
+
+        //a producer process
+        const uint64_t before_fork = buffer.pushed();
+        const pid_t child = fork();
+        if (child == 0) {
+            push_range(buffer, 100000, 20000);
+            _exit(0);
+        }
+        stop.store(false);
+        std::thread fork_sampler([&] { torn = sample_until(reader, stop); });
+        int status = 0;
+        waitpid(child, &status, 0);
+        stop.store(true);
+        fork_sampler.join();
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        CHECK(torn == 0);
+        CHECK(buffer.pushed() == before_fork + 20000);
+
+        //a producer that died in the middle of a record: its slot is taken over
+        const pid_t dead = fork();
+        if (dead == 0) _exit(0);
+        waitpid(dead, &status, 0);
+        mark_next_slot(buffer, dead);
+        const SelfPlayRecord after_dead = make_record(200000);
+        buffer.push(&after_dead, 1);
+        CHECK(newest_is(reader, 200000));
+
+        //a producer that is slow, however long: its slot is waited for and not overwritten
+        const pid_t slow = fork();
+        if (slow == 0) {
+            pause();
+            _exit(0);
+        }
+        mark_next_slot(buffer, slow);
+        std::atomic<bool> pushed{false};
+        std::thread waiter([&] {
+            const SelfPlayRecord record = make_record(200001);
+            buffer.push(&record, 1);
+            pushed.store(true);
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        CHECK(!pushed.load());
+        kill(slow, SIGKILL);
+        waitpid(slow, &status, 0);
+        waiter.join();
+        CHECK(pushed.load());
+        CHECK(newest_is(reader, 200001));
+    }
+    //the creating buffer removed the name
+    CHECK_THROWS(ReplayBuffer opened(name), std::runtime_error);
+    return check_result();
+}
@@ -0,0 +1,124 @@
+#include "SearchService.h"
+#include "game.h"
+#include "check.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// The search service: results that only depend on the seed and the submission order, cancelling queued
+// and running jobs, done callbacks, and submits that race with a shutdown
+
+static std::vector<uint64_t> game_boards(size_t n) {
+    std::vector<uint64_t> boards;
+    uint64_t board = new_game_board();
+    while (boards.size() < n) {
+        if (is_game_over(board)) board = new_game_board();
+        boards.push_back(board);
+        board = add_new_tile(std::get<0>(move(board, compute_simple_best_move(board, 0))));
+    }
+    return boards;
+}
+
+static bool wait_for_status(const SearchJob& job, SearchJob::Status status) {
+    for (int i = 0; i < 5000 && job.status() != status; ++i) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return job.status() == status;
+}
+
+int main() {
+    const std::vector<uint64_t> boards = game_boards(24);
+    SearchConfig mc;
+    mc.samples = 50;
+
+    //the same seed and submissions give the same results on any number of workers
+    {
+        SearchService one(1, 7), three(3, 7);
+        const auto first = one.submit_batch(boards, mc);
+        const auto second = three.submit_batch(boards, mc);
+        bool same = true;
+        for (size_t i = 0; i < boards.size(); ++i) {
+            const SearchResult a = first[i]->result(), b = second[i]->result();
+            same = same && a.move == b.move && a.scores == b.scores;
+        }
+        CHECK(same);
+        CHECK(one.pending() == 0 && three.pending() == 0);
+    }
+
+    SearchConfig long_search;
+    long_search.samples = 1000000;
+    long_search.depth = 1000;
+    {
+        SearchService service(1);
+        //a running job stops at the next chunk of its rollouts
+        const auto running = service.submit(boards[3], long_search);
+        CHECK(wait_for_status(*running, SearchJob::RUNNING));
+
+        //jobs queued behind it are cancelled right away, their callbacks run once
+        std::atomic<int> callbacks(0);
+        const auto queued = service.submit_batch(boards, mc);
+        for (const auto& job : queued) job->on_done([&](SearchJob&) { callbacks++; });
+        for (const auto& job : queued) CHECK(job->cancel());
+        CHECK(callbacks.load() == (int)queued.size());
+        for (const auto& job : queued) CHECK(job->status() == SearchJob::CANCELLED);
+        CHECK_THROWS(queued[0]->result(), std::runtime_error);
+
+        const auto start = std::chrono::steady_clock::now();
+        CHECK(running->cancel());
+        CHECK(running->wait(10 * 1000 * 1000));
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+        CHECK(running->status() == SearchJob::CANCELLED);
+        CHECK_THROWS(running->result(), std::runtime_error);
+
+        //the worker drops the cancelled jobs and goes on with new ones
+        const auto after = service.submit(boards[5], mc);
+        CHECK(after->wait(10 * 1000 * 1000) && after->status() == SearchJob::DONE);
+        CHECK(!after->cancel());
+        CHECK(service.pending() == 0);
+
+        //expectimax stops at its next chance node
+        SearchConfig expectimax;
+        expectimax.search = "expectimax";
+        expectimax.depth = 12;
+        expectimax.min_probability = 0;
+        const auto deep = service.submit(boards[10], expectimax);
+        CHECK(wait_for_status(*deep, SearchJob::RUNNING));
+        CHECK(deep->cancel());
+        CHECK(deep->wait(30 * 1000 * 1000) && deep->status() == SearchJob::CANCELLED);
+
+        SearchConfig unknown;
+        unknown.search = "alphazero";
+        CHECK_THROWS(service.submit(boards[0], unknown), std::invalid_argument);
+    }
+
+    //a submitter racing with the shutdown: every job it got back ends, either done or cancelled
+    for (int round = 0; round < 20; ++round) {
+        SearchService service(2);
+        std::vector<std::shared_ptr<SearchJob>> jobs;
+        std::atomic<bool> started(false);
+        std::thread submitter([&] {
+            SearchConfig quick;
+            quick.samples = 2;
+            quick.depth = 2;
+            try {
+                while (true) {
+                    const auto batch = service.submit_batch({boards[0], boards[1], boards[2], boards[3]}, quick);
+                    jobs.insert(jobs.end(), batch.begin(), batch.end());
+                    started = true;
+                }
+            } catch (const std::runtime_error&) {
+            }
+        });
+        while (!started.load()) std::this_thread::yield();
+        service.shutdown();
+        submitter.join();
+        int stuck = 0;
+        for (const auto& job : jobs) {
+            if (!job->wait(1000 * 1000)) ++stuck;
+        }
+        CHECK(stuck == 0);
+        CHECK(service.pending() == 0);
+        CHECK_THROWS(service.submit(boards[0], mc), std::runtime_error);
+    }
+    return check_result();
+}
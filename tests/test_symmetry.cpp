@@ -0,0 +1,90 @@
+#include "game.h"
+#include "tables.h"
+#include "Random.h"
+#include "check.h"
+#include <set>
+#include <tuple>
+#include <vector>
+
+// The 8 board symmetries: cell permutations against a plain coordinate mapping, the move tables that go
+// with them, and the canonical forms of single boards and batches
+
+// Cell (row, col) of the k-th symmetry comes from this cell of the board, for the order of apply_symmetry:
+// transpose if k & 4, then reverse the rows if k & 2, then mirror every row if k & 1
+static uint64_t reference_symmetry(uint64_t board, unsigned k) {
+    uint64_t out = 0;
+    for (int row = 0; row < 4; ++row) {
+        for (int col = 0; col < 4; ++col) {
+            int r = row, c = col;
+            if (k & 1) c = 3 - c;
+            if (k & 2) r = 3 - r;
+            if (k & 4) std::swap(r, c);
+            out |= ((board >> (4 * (r * 4 + c))) & 0xF) << (4 * (row * 4 + col));
+        }
+    }
+    return out;
+}
+
+int main() {
+    for (unsigned k = 0; k < 8; ++k) {
+        for (unsigned d = 0; d < 4; ++d) {
+            CHECK(symmetry_moves[k][inverse_symmetry_moves[k][d]] == d);
+            CHECK(inverse_symmetry_moves[k][symmetry_moves[k][d]] == d);
+        }
+    }
+
+    Rng rng(17);
+    std::vector<uint64_t> boards;
+    for (int i = 0; i < 2000; ++i) {
+        uint64_t board = 0;
+        for (int c = 0; c < 16; ++c) {
+            if (rng.bounded(3)) board |= (uint64_t)(1 + rng.bounded(11)) << (4 * c);
+        }
+        boards.push_back(board);
+    }
+    //symmetric positions, to make sure their canonical forms are the same
+    boards.push_back(0x1000000000000000ULL);
+    boards.push_back(0x0000000000000001ULL);
+
+    int bad_permutations = 0, bad_moves = 0, bad_canonical = 0;
+    for (uint64_t board : boards) {
+        uint64_t symmetries[8];
+        board_symmetries(board, symmetries);
+        const CanonicalBoard canonical = canonical_board(board);
+        if (apply_symmetry(board, canonical.symmetry) != canonical.board) ++bad_canonical;
+        for (unsigned k = 0; k < 8; ++k) {
+            if (symmetries[k] != apply_symmetry(board, k) || symmetries[k] != reference_symmetry(board, k)) ++bad_permutations;
+            if (canonical_board(symmetries[k]).board != canonical.board || canonical.board > symmetries[k]) ++bad_canonical;
+            //moving and then transforming is the same as transforming and making the matching move
+            for (unsigned d = 0; d < 4; ++d) {
+                const auto [after, score] = move(board, d);
+                const auto [symmetric_after, symmetric_score] = move(symmetries[k], symmetry_moves[k][d]);
+                if (apply_symmetry(after, k) != symmetric_after || score != symmetric_score) ++bad_moves;
+            }
+        }
+    }
+    CHECK(bad_permutations == 0);
+    CHECK(bad_moves == 0);
+    CHECK(bad_canonical == 0);
+    CHECK(canonical_board(0x1000000000000000ULL).board == canonical_board(1).board);
+
+    //the batch functions agree with the single board ones, transform_boards to the canonical symmetry gives
+    //the canonical board
+    const size_t n = boards.size();
+    std::vector<uint64_t> canonical(n), transformed(n);
+    std::vector<uint8_t> symmetry(n);
+    canonicalize_boards(boards.data(), canonical.data(), symmetry.data(), n);
+    transform_boards(boards.data(), symmetry.data(), transformed.data(), n);
+    int bad_batch = 0;
+    for (size_t i = 0; i < n; ++i) {
+        const CanonicalBoard single = canonical_board(boards[i]);
+        if (canonical[i] != single.board || symmetry[i] != single.symmetry || transformed[i] != canonical[i]) ++bad_batch;
+    }
+    CHECK(bad_batch == 0);
+
+    //a board without symmetries has 8 different images
+    uint64_t symmetries[8];
+    board_symmetries(0x0000000000004321ULL | (5ULL << 20), symmetries);
+    CHECK(std::set<uint64_t>(symmetries, symmetries + 8).size() == 8);
+    return check_result();
+}
@@ -0,0 +1,45 @@
+#include "ThreadPool.h"
+#include "check.h"
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+// parallel_for runs every task once, rethrows the first exception of a task on the calling thread and
+// runs nested calls inline
+
+int main() {
+    ThreadPool pool(4);
+
+    std::vector<int> runs(1000, 0);
+    pool.parallel_for(runs.size(), [&](size_t i) { runs[i]++; });
+    bool once = true;
+    for (int r : runs) once = once && r == 1;
+    CHECK(once);
+
+    //many short calls: the completion state of every call lives on the caller's stack
+    std::atomic<size_t> total(0);
+    for (int call = 0; call < 20000; ++call) {
+        pool.parallel_for(3, [&](size_t) { total.fetch_add(1); });
+    }
+    CHECK(total.load() == 60000);
+
+    std::atomic<size_t> finished(0);
+    CHECK_THROWS(pool.parallel_for(64, [&](size_t i) {
+        if (i % 7 == 3) throw std::runtime_error("task failed");
+        finished.fetch_add(1);
+    }), std::runtime_error);
+    CHECK(finished.load() == 64 - 9);
+
+    //the pool keeps working after a failed call
+    total.store(0);
+    pool.parallel_for(100, [&](size_t) { total.fetch_add(1); });
+    CHECK(total.load() == 100);
+
+    total.store(0);
+    pool.parallel_for(8, [&](size_t) {
+        pool.parallel_for(8, [&](size_t) { total.fetch_add(1); });
+    });
+    CHECK(total.load() == 64);
+
+    return check_result();
+}
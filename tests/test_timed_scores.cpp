@@ -0,0 +1,96 @@
+#include "game.h"
+#include "tables.h"
+#include "Random.h"
+#include "check.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// The deadline-bounded rollout search: wall time within the budget and a tolerance, on one and on several
+// workers, rollout counts that add up and means that match the rollouts, and the boards that return at once
+
+static std::vector<uint64_t> game_boards(size_t n) {
+    std::vector<uint64_t> boards;
+    uint64_t board = new_game_board();
+    while (boards.size() < n) {
+        if (is_game_over(board)) board = new_game_board();
+        if (get_possible_moves(board).size() > 1) boards.push_back(board);
+        board = add_new_tile(std::get<0>(move(board, compute_simple_best_move(board, 0))));
+    }
+    return boards;
+}
+
+// Runs the search and returns it with the wall time around the call
+static std::pair<TimedScores, double> timed(uint64_t board, int64_t budget_us, int depth) {
+    const auto start = std::chrono::steady_clock::now();
+    const TimedScores result = compute_timed_scores(board, budget_us, depth, 3);
+    return {result, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count()};
+}
+
+int main() {
+    set_seed(20);
+    const std::vector<uint64_t> boards = game_boards(60);
+    const int64_t budget_us = 20000;
+    //one rollout after the deadline plus the wake up of the workers, generous for a loaded machine
+    const double tolerance_us = 30000;
+
+    for (int threads : {1, 3}) {
+        set_num_threads(threads);
+        int over_budget = 0, bad_elapsed = 0, bad_counts = 0, bad_means = 0, bad_best = 0;
+        for (size_t i = 0; i < boards.size(); i += 6) {
+            const Successors next = successors(boards[i]);
+            //depth 0 rollouts return the merge of the move, so every mean is exactly that
+            for (int depth : {0, 30}) {
+                const auto [result, wall_us] = timed(boards[i], budget_us, depth);
+                over_budget += wall_us > budget_us + tolerance_us;
+                bad_elapsed += result.elapsed_us < budget_us || result.elapsed_us > wall_us;
+                uint64_t total = 0;
+                for (uint d = 0; d < 4; ++d) {
+                    total += result.counts[d];
+                    if (!(next.legal & (1u << d))) {
+                        bad_counts += result.counts[d] != 0;
+                        bad_means += result.means[d] != 0;
+                        continue;
+                    }
+                    bad_counts += result.counts[d] <= 0;
+                    if (depth == 0) bad_means += result.means[d] != next.scores[d];
+                    else bad_means += result.means[d] < next.scores[d];
+                    bad_best += result.means[d] > result.means[result.best_move];
+                }
+                bad_counts += result.rollouts == 0 || total != result.rollouts;
+                bad_best += !(next.legal & (1u << result.best_move));
+            }
+        }
+        CHECK(over_budget == 0);
+        CHECK(bad_elapsed == 0);
+        CHECK(bad_counts == 0);
+        CHECK(bad_means == 0);
+        CHECK(bad_best == 0);
+    }
+    set_num_threads(1);
+
+    //no budget: no rollouts, a possible move
+    {
+        const Successors next = successors(boards[0]);
+        const TimedScores result = compute_timed_scores(boards[0], 0, 30, 3);
+        CHECK(result.rollouts == 0);
+        CHECK(next.legal & (1u << result.best_move));
+    }
+
+    //a single possible move returns before the budget
+    {
+        uint64_t board = 0;
+        const unsigned rows[3][4] = {{1, 2, 1, 2}, {2, 1, 2, 1}, {1, 2, 1, 2}};
+        for (int row = 0; row < 3; ++row) {
+            for (int col = 0; col < 4; ++col) board |= (uint64_t)rows[row][col] << (4 * (4 * (row + 1) + col));
+        }
+        const auto [result, wall_us] = timed(board, 1000000, 30);
+        CHECK(result.rollouts == 0);
+        CHECK(result.best_move == 2);
+        CHECK(wall_us < 100000);
+    }
+    return check_result();
+}
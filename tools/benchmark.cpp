@@ -0,0 +1,237 @@
+#include "game.h"
+#include "Random.h"
+#include "Stats.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Native benchmark of the engine, prints one JSON document to stdout so that runs of different builds
+// and -march settings can be compared. usage: benchmark [--quick] [--seed N]. built with MCTS2048_STATS
+// the document also has the search stats of the whole run
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    std::string name;
+    std::string unit;
+    double value;
+    int threads;
+};
+
+// Keeps the compiler from dropping the benchmarked calls
+volatile uint64_t sink;
+
+double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Boards from real games, so that the moves see the usual mix of tiles. every game is played with
+// policy 0 and every position is kept until n boards are collected
+std::vector<uint64_t> game_boards(size_t n) {
+    std::vector<uint64_t> boards;
+    boards.reserve(n);
+    while (boards.size() < n) {
+        uint64_t board = new_game_board();
+        while (!is_game_over(board) && boards.size() < n) {
+            boards.push_back(board);
+            board = add_new_tile(get<0>(move(board, compute_simple_best_move(board, 0))));
+        }
+    }
+    return boards;
+}
+
+// Calls fn(board) for every board, repeated until min_seconds have passed, and returns ns per call
+template <typename Fn>
+double ns_per_op(const std::vector<uint64_t>& boards, double min_seconds, Fn fn) {
+    uint64_t acc = 0;
+    size_t calls = 0;
+    const auto start = Clock::now();
+    double elapsed = 0;
+    do {
+        for (uint64_t board : boards) acc += fn(board);
+        calls += boards.size();
+        elapsed = seconds_since(start);
+    } while (elapsed < min_seconds);
+    sink = acc;
+    return elapsed * 1e9 / calls;
+}
+
+// Plays games with a policy until min_seconds have passed, and returns moves per second
+double policy_steps_per_second(int policy, double min_seconds) {
+    uint64_t steps = 0;
+    const auto start = Clock::now();
+    double elapsed = 0;
+    do {
+        uint64_t board = new_game_board();
+        while (!is_game_over(board)) {
+            board = add_new_tile(get<0>(move(board, compute_simple_best_move(board, policy))));
+            ++steps;
+        }
+        elapsed = seconds_since(start);
+    } while (elapsed < min_seconds);
+    return steps / elapsed;
+}
+
+// Runs compute_scores on the boards until min_seconds have passed, and returns rollouts per second
+double rollouts_per_second(const std::vector<uint64_t>& boards, int samples, int depth, int policy, double min_seconds) {
+    double acc = 0;
+    uint64_t rollouts = 0;
+    const auto start = Clock::now();
+    double elapsed = 0;
+    size_t i = 0;
+    do {
+        const uint64_t board = boards[i++ % boards.size()];
+        const vector<uint> moves = get_possible_moves(board);
+        const vector<double> scores = compute_scores(board, samples, depth, policy, moves);
+        acc += scores[0];
+        rollouts += (uint64_t)samples * moves.size();
+        elapsed = seconds_since(start);
+    } while (elapsed < min_seconds);
+    sink = (uint64_t)acc;
+    return rollouts / elapsed;
+}
+
+void print_string(const char* key, const std::string& value, bool last = false) {
+    std::printf("    \"%s\": \"%s\"%s\n", key, value.c_str(), last ? "" : ",");
+}
+
+std::string compiler() {
+#if defined(__clang__)
+    return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+    return std::string("gcc ") + __VERSION__;
+#else
+    return "unknown";
+#endif
+}
+
+std::string target_features() {
+    std::string features;
+#ifdef __AVX2__
+    features += " avx2";
+#endif
+#ifdef __BMI2__
+    features += " bmi2";
+#endif
+#ifdef __AVX512F__
+    features += " avx512f";
+#endif
+    return features.empty() ? "baseline" : features.substr(1);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool quick = false;
+    uint64_t seed = 2048;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--quick") == 0) {
+            quick = true;
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else {
+            std::fprintf(stderr, "usage: %s [--quick] [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+    const double min_seconds = quick ? 0.05 : 0.5;
+
+    set_seed(seed);
+    const std::vector<uint64_t> boards = game_boards(1 << 16);
+
+    std::vector<Result> results;
+
+    const char* direction_names[4] = {"left", "right", "up", "down"};
+    for (int direction = 0; direction < 4; ++direction) {
+        const double ns = ns_per_op(boards, min_seconds, [direction](uint64_t board) {
+            auto [next, score] = move(board, direction);
+            return next + score;
+        });
+        results.push_back({std::string("move_") + direction_names[direction], "ns/op", ns, 1});
+    }
+
+    {
+        std::vector<uint64_t> out_boards(boards.size());
+        std::vector<uint32_t> out_scores(boards.size());
+        std::vector<int32_t> directions(boards.size());
+        for (size_t i = 0; i < boards.size(); ++i) directions[i] = (int32_t)(i & 3);
+        const std::vector<uint64_t> one = {0};
+        const double ns = ns_per_op(one, min_seconds, [&](uint64_t) {
+            move_batch(boards.data(), directions.data(), out_boards.data(), out_scores.data(), boards.size());
+            return out_boards[0];
+        }) / boards.size();
+        results.push_back({"move_batch", "ns/op", ns, 1});
+    }
+
+    results.push_back({"add_new_tile", "ns/op", ns_per_op(boards, min_seconds, [](uint64_t board) {
+        return add_new_tile(board);
+    }), 1});
+    results.push_back({"is_game_over", "ns/op", ns_per_op(boards, min_seconds, [](uint64_t board) {
+        return (uint64_t)is_game_over(board);
+    }), 1});
+    results.push_back({"get_possible_moves", "ns/op", ns_per_op(boards, min_seconds, [](uint64_t board) {
+        return (uint64_t)get_possible_moves(board).size();
+    }), 1});
+
+    {
+        std::vector<float> features(boards.size() * n_features);
+        const std::vector<uint64_t> one = {0};
+        const double ns = ns_per_op(one, min_seconds, [&](uint64_t) {
+            extract_features(boards.data(), features.data(), boards.size());
+            return (uint64_t)features[0];
+        }) / boards.size();
+        results.push_back({"extract_features", "ns/op", ns, get_num_threads()});
+    }
+
+    for (int policy = 0; policy <= 6; ++policy) {
+        results.push_back({"compute_simple_best_move_policy_" + std::to_string(policy), "steps/s",
+                           policy_steps_per_second(policy, min_seconds), 1});
+    }
+
+    // the thread counts: 1, 2, 4, ... up to the hardware, and the hardware itself
+    const int hardware = (int)std::max(1u, std::thread::hardware_concurrency());
+    std::vector<int> thread_counts;
+    for (int n = 1; n < hardware; n *= 2) thread_counts.push_back(n);
+    thread_counts.push_back(hardware);
+
+    const int settings[][2] = {{100, 10}, {1000, 10}, {1000, 50}, {200, 200}};
+    const std::vector<uint64_t> rollout_boards(boards.begin(), boards.begin() + 256);
+    for (int n_threads : thread_counts) {
+        set_num_threads(n_threads);
+        for (const auto& setting : settings) {
+            const int samples = setting[0];
+            const int depth = setting[1];
+            results.push_back({"compute_scores_s" + std::to_string(samples) + "_d" + std::to_string(depth),
+                               "rollouts/s",
+                               rollouts_per_second(rollout_boards, samples, depth, 0, min_seconds),
+                               n_threads});
+        }
+    }
+    set_num_threads(0);
+
+    std::printf("{\n");
+    std::printf("  \"build\": {\n");
+    print_string("compiler", compiler());
+    print_string("target_features", target_features());
+    print_string("move_batch_kernel", move_batch_kernel_name());
+    std::printf("    \"hardware_threads\": %d,\n", hardware);
+    std::printf("    \"seed\": %llu\n", (unsigned long long)seed);
+    std::printf("  },\n");
+    std::printf("  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        std::printf("    {\"name\": \"%s\", \"unit\": \"%s\", \"threads\": %d, \"value\": %.6g}%s\n",
+                    r.name.c_str(), r.unit.c_str(), r.threads, r.value, i + 1 < results.size() ? "," : "");
+    }
+    std::printf("  ]%s\n", MCTS2048_STATS ? "," : "");
+    if (MCTS2048_STATS) std::printf("  \"stats\": %s\n", stats_json(get_stats()).c_str());
+    std::printf("}\n");
+    return 0;
+}
@@ -0,0 +1,269 @@
+#include "game.h"
+#include "Geometry.h"
+#include "DatasetGenerator.h"
+#include "Network.h"
+#include "NTupleNetwork.h"
+#include "MCTS.h"
+#include "Random.h"
+#include "ThreadPool.h"
+#include "Stats.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Plays games with one search configuration and prints throughput and score statistics, without python.
+// the games run concurrently on the rollout pool, every search inside a game then runs on its own thread.
+// every game draws from its own random stream, so the results do not depend on the number of threads.
+// with --output the games are played by the DatasetGenerator instead and their positions written to a file
+
+namespace {
+
+struct Config {
+    std::string search = "mc";     // mc, adaptive, paired, expectimax, mcts or policy
+    int games = 10;
+    int samples = 1000;            // mc, paired, adaptive: at most this many
+    int depth = 10;                // mc, adaptive, paired and mcts: rollout depth, expectimax: search depth
+    int policy = 0;                // rollout policy of mc, adaptive, paired and mcts, move policy of policy
+    double z = 2.0;                // adaptive: confidence interval half width in standard errors
+    int64_t budget_us = 0;         // mc and mcts: time per move instead of samples/iterations, 0: off
+    double min_probability = 1e-4; // expectimax
+    int iterations = 1000;         // mcts
+    size_t capacity = 1 << 20;     // mcts
+    double exploration = 1.0;      // mcts
+    int threads = 0;
+    uint64_t seed = 2048;
+    std::string output;            // dataset file, empty: no dataset
+    uint64_t records = 20000;      // dataset: records the file should hold
+    std::string policy_network;    // weight file for policy 7
+    std::string value_network;
+    std::string ntuple_network;    // expectimax leaf and policy 8
+    std::string geometry = "4x4x4"; // other geometries play mc, expectimax or policy with the geometry policies
+};
+
+struct GameResult {
+    uint64_t score = 0;
+    uint64_t moves = 0;
+    uint64_t max_tile = 0;
+};
+
+void usage(const char* name) {
+    std::fprintf(stderr,
+                 "usage: %s [options]\n"
+                 "  --search mc|adaptive|paired|expectimax|mcts|policy  search that picks the moves (default mc)\n"
+                 "  --games N            number of games (default 10)\n"
+                 "  --samples N          mc and paired: rollouts per move, adaptive: at most this many (default 1000)\n"
+                 "  --depth N            mc, adaptive, paired and mcts: rollout depth, expectimax: search depth (default 10)\n"
+                 "  --policy N           rollout policy of mc, adaptive, paired and mcts, move policy of policy (default 0)\n"
+                 "  --z Z                adaptive: confidence bound in standard errors (default 2)\n"
+                 "  --budget-us N        mc and mcts: search every move for N microseconds instead of --samples/--iterations\n"
+                 "  --min-probability P  expectimax: probability cutoff (default 1e-4)\n"
+                 "  --iterations N       mcts: iterations per move (default 1000)\n"
+                 "  --capacity N         mcts: nodes in the arena (default 1048576)\n"
+                 "  --exploration C      mcts: exploration constant (default 1.0)\n"
+                 "  --threads N          worker threads, <= 0 uses all cores (default 0)\n"
+                 "  --seed N             random seed (default 2048)\n"
+                 "  --output FILE        write a self-play dataset with the mc scores to FILE, continues an existing file\n"
+                 "  --records N          dataset: records the file should hold (default 20000)\n"
+                 "  --policy-network F   policy network weights, used by policy 7\n"
+                 "  --value-network F    value network weights\n"
+                 "  --ntuple F           n-tuple network, expectimax leaf value and policy 8\n"
+                 "  --geometry G         board: 4x4x4 (default), 4x4x5 (5 bit cells), 3x3x4 or 5x5x4, others than\n"
+                 "                       4x4x4 support --search mc, expectimax and policy with the policies 1-3 and 9\n"
+                 "                       (max merge), no --output\n",
+                 name);
+}
+
+bool parse_args(int argc, char** argv, Config& config) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (i + 1 >= argc) return false;
+        const char* value = argv[++i];
+        if (std::strcmp(arg, "--search") == 0) config.search = value;
+        else if (std::strcmp(arg, "--games") == 0) config.games = std::atoi(value);
+        else if (std::strcmp(arg, "--samples") == 0) config.samples = std::atoi(value);
+        else if (std::strcmp(arg, "--depth") == 0) config.depth = std::atoi(value);
+        else if (std::strcmp(arg, "--policy") == 0) config.policy = std::atoi(value);
+        else if (std::strcmp(arg, "--z") == 0) config.z = std::atof(value);
+        else if (std::strcmp(arg, "--budget-us") == 0) config.budget_us = std::strtoll(value, nullptr, 10);
+        else if (std::strcmp(arg, "--min-probability") == 0) config.min_probability = std::atof(value);
+        else if (std::strcmp(arg, "--iterations") == 0) config.iterations = std::atoi(value);
+        else if (std::strcmp(arg, "--capacity") == 0) config.capacity = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(arg, "--exploration") == 0) config.exploration = std::atof(value);
+        else if (std::strcmp(arg, "--threads") == 0) config.threads = std::atoi(value);
+        else if (std::strcmp(arg, "--seed") == 0) config.seed = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(arg, "--output") == 0) config.output = value;
+        else if (std::strcmp(arg, "--records") == 0) config.records = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(arg, "--policy-network") == 0) config.policy_network = value;
+        else if (std::strcmp(arg, "--value-network") == 0) config.value_network = value;
+        else if (std::strcmp(arg, "--ntuple") == 0) config.ntuple_network = value;
+        else if (std::strcmp(arg, "--geometry") == 0) config.geometry = value;
+        else return false;
+    }
+    if (config.geometry != "4x4x4" &&
+        ((config.search != "mc" && config.search != "expectimax" && config.search != "policy") || !config.output.empty())) {
+        return false;
+    }
+    return config.search == "mc" || config.search == "adaptive" || config.search == "paired" || config.search == "expectimax" ||
+           config.search == "mcts" || config.search == "policy";
+}
+
+uint64_t max_tile(uint64_t board) {
+    int rank = 0;
+    for (int i = 0; i < 16; ++i) rank = std::max(rank, (int)((board >> (i * 4)) & 0xF));
+    return rank == 0 ? 0 : 1ULL << rank;
+}
+
+// A game on another board geometry, with the mc or expectimax search or a policy
+GameResult play_geometry_game(const Config& config) {
+    const GeometryFunctions& geometry = geometry_functions(config.geometry);
+    GameResult result;
+    WideBoard board = geometry.new_game();
+    while (geometry.legal_moves(board) != 0) {
+        unsigned direction;
+        if (config.search == "mc") direction = geometry.best_move(board, config.samples, config.depth, config.policy);
+        else if (config.search == "expectimax") direction = geometry.expectimax_move(board, config.depth, config.min_probability);
+        else direction = geometry.policy_move(board, config.policy);
+        const auto [next, score] = geometry.move(board, direction);
+        board = geometry.add_new_tile(next);
+        result.score += score;
+        result.moves++;
+    }
+    result.max_tile = geometry.max_tile(board);
+    return result;
+}
+
+GameResult play_game(const Config& config) {
+    if (config.geometry != "4x4x4") return play_geometry_game(config);
+    std::unique_ptr<MCTS> tree;
+    if (config.search == "mcts") {
+        tree = std::make_unique<MCTS>(config.capacity, config.exploration, config.depth, config.policy);
+    }
+
+    GameResult result;
+    uint64_t board = new_game_board();
+    while (!is_game_over(board)) {
+        uint direction;
+        if (config.search == "mc" && config.budget_us > 0) direction = compute_timed_best_move(board, config.budget_us, config.depth, config.policy);
+        else if (config.search == "mc") direction = compute_best_move(board, config.samples, config.depth, config.policy);
+        else if (config.search == "adaptive") direction = compute_adaptive_best_move(board, config.samples, config.depth, config.policy, config.z);
+        else if (config.search == "paired") direction = compute_paired_best_move(board, config.samples, config.depth, config.policy);
+        else if (config.search == "expectimax") direction = compute_expectimax_move(board, config.depth, config.min_probability);
+        else if (config.search == "mcts" && config.budget_us > 0) direction = tree->search_for(board, config.budget_us).move;
+        else if (config.search == "mcts") direction = tree->search(board, config.iterations);
+        else direction = compute_simple_best_move(board, config.policy);
+
+        auto [next, score] = move(board, direction);
+        board = add_new_tile(next);
+        result.score += score;
+        result.moves++;
+    }
+    result.max_tile = max_tile(board);
+    return result;
+}
+
+// Runs the dataset generator and reports its progress once per second on stderr
+int generate_dataset(const Config& config) {
+    DatasetGenerator generator(config.output, config.samples, config.depth, config.policy);
+    std::atomic<bool> done(false);
+    const auto start = std::chrono::steady_clock::now();
+    std::thread progress([&] {
+        double next_report = 1.0;
+        while (!done.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (elapsed < next_report) continue;
+            next_report += 1.0;
+            std::fprintf(stderr, "\r%llu/%llu records, %llu games, %.0f s", (unsigned long long)generator.records(),
+                         (unsigned long long)config.records, (unsigned long long)generator.games(), elapsed);
+        }
+    });
+
+    uint64_t records = 0;
+    try {
+        records = generator.run(config.records);
+    } catch (const std::exception& e) {
+        done.store(true);
+        progress.join();
+        std::fprintf(stderr, "\n%s\n", e.what());
+        return 1;
+    }
+    done.store(true);
+    progress.join();
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("\nwrote %s: %llu records, %llu games finished, %.3f s\n", config.output.c_str(),
+                (unsigned long long)records, (unsigned long long)generator.games(), elapsed);
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Config config;
+    if (!parse_args(argc, argv, config) || config.games <= 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    try {
+        if (!config.policy_network.empty()) load_policy_network(config.policy_network);
+        if (!config.value_network.empty()) load_value_network(config.value_network);
+        if (!config.ntuple_network.empty()) set_ntuple_network(std::make_shared<NTupleNetwork>(config.ntuple_network));
+        geometry_functions(config.geometry);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    set_num_threads(config.threads);
+    set_seed(config.seed);
+    if (!config.output.empty()) return generate_dataset(config);
+
+    std::vector<GameResult> results(config.games);
+    const auto start = std::chrono::steady_clock::now();
+    get_rollout_pool().parallel_for(config.games, [&](size_t game) {
+        seed_thread_rng(config.seed, 1000000 + game);
+        results[game] = play_game(config);
+    });
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::vector<double> scores;
+    uint64_t total_moves = 0;
+    for (const GameResult& r : results) {
+        scores.push_back((double)r.score);
+        total_moves += r.moves;
+    }
+    std::sort(scores.begin(), scores.end());
+    double mean = 0;
+    for (double s : scores) mean += s;
+    mean /= scores.size();
+    double variance = 0;
+    for (double s : scores) variance += (s - mean) * (s - mean);
+    const double stddev = scores.size() > 1 ? std::sqrt(variance / (scores.size() - 1)) : 0.0;
+    const double median = scores.size() % 2 ? scores[scores.size() / 2]
+                                            : (scores[scores.size() / 2 - 1] + scores[scores.size() / 2]) / 2;
+
+    std::printf("search: %s, geometry: %s, games: %d, threads: %d, seed: %llu\n", config.search.c_str(),
+                config.geometry.c_str(), config.games, get_num_threads(), (unsigned long long)config.seed);
+    std::printf("time: %.3f s, %.1f moves/s, %.3f games/s\n", elapsed, total_moves / elapsed, config.games / elapsed);
+    std::printf("score: mean %.1f, std %.1f, min %.0f, median %.1f, max %.0f\n", mean, stddev, scores.front(), median,
+                scores.back());
+    std::printf("moves per game: %.1f\n", (double)total_moves / config.games);
+    std::printf("max tile reached:\n");
+    uint64_t highest = 0;
+    for (const GameResult& r : results) highest = std::max(highest, r.max_tile);
+    for (uint64_t tile = 64; tile <= highest; tile *= 2) {
+        int reached = 0;
+        for (const GameResult& r : results) reached += r.max_tile >= tile;
+        std::printf("  %6llu: %5.1f%%\n", (unsigned long long)tile, 100.0 * reached / config.games);
+    }
+    if (MCTS2048_STATS) std::printf("stats: %s\n", stats_json(get_stats()).c_str());
+    return 0;
+}
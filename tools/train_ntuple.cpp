@@ -0,0 +1,62 @@
+#include "game.h"
+#include "NTupleNetwork.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+// Trains an n-tuple network with TD(0) self-play on all cores and saves it after every block of games,
+// so a long run can be stopped at any time. --input continues an earlier run
+
+int main(int argc, char** argv) {
+    uint64_t games = 100000;
+    uint64_t block = 10000;
+    float learning_rate = 0.1f;
+    int threads = 0;
+    uint64_t seed = 2048;
+    std::string input;
+    std::string output = "ntuple.bin";
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char* arg = argv[i];
+        const char* value = argv[i + 1];
+        if (std::strcmp(arg, "--games") == 0) games = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(arg, "--block") == 0) block = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(arg, "--learning-rate") == 0) learning_rate = (float)std::atof(value);
+        else if (std::strcmp(arg, "--threads") == 0) threads = std::atoi(value);
+        else if (std::strcmp(arg, "--seed") == 0) seed = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(arg, "--input") == 0) input = value;
+        else if (std::strcmp(arg, "--output") == 0) output = value;
+        else argc = 0;
+    }
+    if (argc % 2 == 0 || block == 0) {
+        std::fprintf(stderr,
+                     "usage: %s [--games N] [--block N] [--learning-rate A] [--threads N] [--seed N] [--input F] [--output F]\n"
+                     "  trains --games games (default 100000) and saves --output (default ntuple.bin) every --block games\n",
+                     argv[0]);
+        return 2;
+    }
+
+    set_num_threads(threads);
+    set_seed(seed);
+    try {
+        auto network = input.empty() ? std::make_unique<NTupleNetwork>() : std::make_unique<NTupleNetwork>(input);
+        const auto start = std::chrono::steady_clock::now();
+        for (uint64_t done = 0; done < games;) {
+            const uint64_t n = std::min(block, games - done);
+            const NTupleNetwork::TrainingResult result = network->train(n, learning_rate);
+            done += n;
+            network->save(output);
+            const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::printf("%llu games, mean score %.1f, max score %llu, %.1f games/s\n", (unsigned long long)done,
+                        result.mean_score, (unsigned long long)result.max_score, done / elapsed);
+            std::fflush(stdout);
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
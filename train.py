@@ -3,46 +3,49 @@ import torch
 import torch.nn as nn
 import torch.optim as optim
 from torch.utils.data import DataLoader, Dataset
-from mcts2048 import board_to_array
+from mcts2048 import extract_features
+from records import open_records, convert_npz, deduplicate, random_symmetries
+import os
 import time
 
 # Preprocessing functions
+def preprocess_boards(boards):
+    # 56 features per board: the log2 tile values divided by the largest one, 12 vertical and 12 horizontal
+    # edges (1 where the neighbours are equal) and the 16 empty cells. computed natively for the whole batch
+    return extract_features(np.asarray(boards, dtype=np.uint64))
+
 def preprocess_board(board):
-    board = np.array(board_to_array(int(board)), dtype=np.float32)
-    board[board != 0] = np.log2(board[board != 0])
-    if board.max() == 0:
-        print(board)
-
-    board /= board.max()
-    vertical_edges = np.zeros((3, 4))
-    horizontal_edges = np.zeros((4, 3))
-    # edges get filled with the info wether the two tiles are the same or not
-    for i in range(4):
-        for j in range(3):
-            horizontal_edges[i, j] = board[i, j] == board[i, j + 1]
-    for i in range(3):
-        for j in range(4):
-            vertical_edges[i, j] = board[i, j] == board[i + 1, j]
-    # then we also need to get the empty tiles
-    empty = np.zeros_like(board)
-    empty[board == 0] = 1
-    ret = np.concatenate([board.flatten(), vertical_edges.flatten(), horizontal_edges.flatten(), empty.flatten()])
-    return ret
+    return preprocess_boards([board])[0]
 
 def preprocess_scores(scores):
     return scores / scores.sum()
 
-# Custom Dataset
+# Custom Dataset, the boards and scores can be memory mapped, they are preprocessed when an item is used.
+# with augment every batch is put in random orientations (rotations and reflections, see records.py)
 class MCTS2048Dataset(Dataset):
-    def __init__(self, boards, scores):
-        self.boards = np.array([preprocess_board(board) for board in boards], dtype=np.float32)
-        self.scores = np.array([preprocess_scores(score) for score in scores], dtype=np.float32)
+    def __init__(self, boards, scores, augment=False):
+        self.boards = boards
+        self.scores = scores
+        self.augment = augment
 
     def __len__(self):
         return len(self.boards)
 
     def __getitem__(self, idx):
-        return torch.tensor(self.boards[idx]), torch.tensor(self.scores[idx])
+        board = preprocess_board(self.boards[idx])
+        scores = np.asarray(preprocess_scores(np.asarray(self.scores[idx], dtype=np.float32)), dtype=np.float32)
+        return torch.tensor(board), torch.tensor(scores)
+
+    # batched fetch, the DataLoader uses it instead of one __getitem__ per board
+    def __getitems__(self, indices):
+        indices = np.sort(np.asarray(indices))
+        boards = self.boards[indices]
+        scores = np.asarray(self.scores[indices], dtype=np.float32)
+        if self.augment:
+            boards, scores = random_symmetries(boards, scores)
+        boards = torch.from_numpy(preprocess_boards(boards))
+        scores = torch.from_numpy(scores / scores.sum(axis=1, keepdims=True))
+        return list(zip(boards, scores))
 
 # Define the dense neural network
 class DenseNetwork(nn.Module):
@@ -83,15 +86,31 @@ def predict_move(board, model):
         probabilities = model(processed_board)
         return probabilities.squeeze(0).cpu().numpy()
 
+# Writes the weights in the format the engine loads (see include/Network.h)
+def export_network(model, path):
+    linears = [layer for layer in model.network if isinstance(layer, nn.Linear)]
+    widths = [linears[0].in_features] + [layer.out_features for layer in linears]
+    with open(path, "wb") as f:
+        f.write(b"M2048MLP")
+        np.array([1, len(linears)] + widths, dtype="<u4").tofile(f)
+        for layer in linears:
+            layer.weight.detach().cpu().numpy().astype("<f4").tofile(f)
+            layer.bias.detach().cpu().numpy().astype("<f4").tofile(f)
+
 # Main script
 if __name__ == "__main__":
-    # Load data
-    data = np.load("training_data.npz")
-    boards = data["boards"]
-    scores = data["scores"]
+    # Load data, the record file is mapped and not read up front (see records.py)
+    if not os.path.exists("training_data.bin") and os.path.exists("training_data.npz"):
+        convert_npz("training_data.npz", "training_data.bin")  # data of the old create_dataset.py
+    records = open_records("training_data.bin")
+    # positions that are equal up to symmetry are kept once, the augmentation brings back all orientations
+    records = deduplicate(records)
+    print(f"{len(records)} unique positions")
+    boards = records["board"]
+    scores = records["scores"]
 
     # Prepare dataset and dataloader
-    dataset = MCTS2048Dataset(boards, scores)
+    dataset = MCTS2048Dataset(boards, scores, augment=True)
     dataloader = DataLoader(dataset, batch_size=256, shuffle=True)
 
     # Set up model, loss, optimizer
@@ -102,6 +121,9 @@ if __name__ == "__main__":
     # Train the model
     train_model(model, dataloader, optimizer, epochs=100)
 
+    # the engine uses it with load_policy_network, as policy 7 and in compute_network_scores
+    export_network(model, "policy_network.bin")
+
     # Example prediction
     example_board = boards[0]  # Take the first board for testing
     probabilities = predict_move(example_board, model)
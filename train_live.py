@@ -0,0 +1,55 @@
+import multiprocessing as mp
+import os
+import time
+import numpy as np
+import torch
+import torch.optim as optim
+from mcts2048 import ReplayBuffer, DatasetGenerator, set_seed
+from records import record_dtype, sample_replay, random_symmetries
+from train import DenseNetwork, preprocess_boards, export_network
+
+# Trains the network while the games are played: self-play processes push their records into a replay
+# buffer in shared memory (include/ReplayBuffer.h), the trainer samples random minibatches from it
+
+BUFFER_NAME = f"m2048_replay_{os.getpid()}"
+CAPACITY = 1 << 20
+PRODUCERS = max(1, (os.cpu_count() or 2) - 1)
+BATCH_SIZE = 256
+STEPS = 20000
+
+def produce(name, seed, total_records):
+    # every producer opens the segment by name, its generator pushes records in chunks of 256
+    set_seed(seed)
+    buffer = ReplayBuffer(name)
+    DatasetGenerator(buffer, samples=1000, depth=10, policy=3).run(total_records)
+
+if __name__ == "__main__":
+    buffer = ReplayBuffer(BUFFER_NAME, CAPACITY)
+    producers = [mp.Process(target=produce, args=(BUFFER_NAME, seed, 10**9), daemon=True) for seed in range(PRODUCERS)]
+    for producer in producers:
+        producer.start()
+
+    device = torch.device("cuda" if torch.cuda.is_available() else "cpu")
+    model = DenseNetwork().to(device)
+    optimizer = optim.Adam(model.parameters(), lr=0.001)
+
+    # the minibatch is drawn into the same record array every step
+    batch = np.empty(BATCH_SIZE, dtype=record_dtype)
+    while len(buffer) < 16 * BATCH_SIZE:
+        time.sleep(0.5)
+    model.train()
+    for step in range(STEPS):
+        records = sample_replay(buffer, BATCH_SIZE, batch)
+        boards, scores = random_symmetries(records["board"], records["scores"])
+        X = torch.from_numpy(preprocess_boards(boards)).to(device)
+        y = torch.from_numpy(scores / scores.sum(axis=1, keepdims=True)).to(device)
+        optimizer.zero_grad()
+        loss = torch.mean((model(X) - y) ** 2)
+        loss.backward()
+        optimizer.step()
+        if (step + 1) % 1000 == 0:
+            print(f"step {step + 1}, loss {loss.item():.4f}, {buffer.pushed()} records pushed, {len(buffer)} in the buffer")
+
+    for producer in producers:
+        producer.terminate()
+    export_network(model, "policy_network.bin")